@@ -0,0 +1,228 @@
+#pragma once
+
+#include <sys/uio.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <span>
+#include <utility>
+#include <vector>
+
+/*
+ * 定长块的缓冲池，每个线程一个(每个reactor线程一个)，不加锁
+ * 空闲块最多保留maxFree个，多出来的直接还给系统
+ */
+class BufferPool {
+public:
+	static constexpr std::size_t kChunkSize = 16 * 1024;
+
+	static BufferPool& local() {
+		static thread_local BufferPool pool;
+		return pool;
+	}
+
+	BufferPool() = default;
+	BufferPool(const BufferPool&) = delete;
+	BufferPool& operator=(const BufferPool&) = delete;
+
+	~BufferPool() {
+		for (std::uint8_t* chunk : m_free) {
+			::operator delete(chunk);
+		}
+	}
+
+	std::uint8_t* acquire() {
+		if (!m_free.empty()) {
+			std::uint8_t* chunk = m_free.back();
+			m_free.pop_back();
+			return chunk;
+		}
+		return static_cast<std::uint8_t*>(::operator new(kChunkSize));
+	}
+
+	void release(std::uint8_t* chunk) {
+		if (m_free.size() < m_maxFree) {
+			m_free.push_back(chunk);
+		} else {
+			::operator delete(chunk);
+		}
+	}
+
+	void setMaxFree(std::size_t maxFree) {
+		m_maxFree = maxFree;
+		while (m_free.size() > m_maxFree) {
+			::operator delete(m_free.back());
+			m_free.pop_back();
+		}
+	}
+
+	std::size_t freeCount() const { return m_free.size(); }
+
+private:
+	std::vector<std::uint8_t*> m_free;
+	std::size_t m_maxFree = 1024;
+};
+
+/*
+ * 由多段内存链成的读缓冲区：增长时在尾部链上新的块，不搬动已有数据
+ * 普通的段是池里的定长块；需要一大段连续内存时(大的帧或body)由pullup分配一段刚好够用的内存
+ * 数据读完的段立即还给池，空的缓冲区不占内存，大量空闲连接几乎不占缓冲区内存
+ * 只在一个线程里使用
+ */
+class ChainBuffer {
+public:
+	// readFd的栈上溢出区大小
+	static constexpr std::size_t kSpillSize = 64 * 1024;
+
+	ChainBuffer() = default;
+	ChainBuffer(const ChainBuffer&) = delete;
+	ChainBuffer& operator=(const ChainBuffer&) = delete;
+	~ChainBuffer() { clear(); }
+
+	std::size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+	std::size_t linkCount() const { return m_links.size(); }
+
+	// 第一段里可读的数据
+	std::span<std::uint8_t> front() {
+		if (m_links.empty()) {
+			return {};
+		}
+		Link& link = m_links.front();
+		return {link.data + link.begin, link.end - link.begin};
+	}
+
+	// 第一段从可读位置起的总容量(已有数据 + 尾部空位)，仅当只有一段时有意义
+	std::size_t frontCapacity() const {
+		return m_links.empty() ? 0 : m_links.front().capacity - m_links.front().begin;
+	}
+
+	// 从头部去掉n字节，读完的段还给池
+	void consume(std::size_t n) {
+		m_size -= n;
+		while (n > 0) {
+			Link& link = m_links.front();
+			std::size_t left = link.end - link.begin;
+			if (n < left) {
+				link.begin += n;
+				return;
+			}
+			n -= left;
+			freeLink(link);
+			m_links.erase(m_links.begin());
+		}
+		// 最后一段读完但还有空位时也还回去，空缓冲区不占内存
+		if (m_size == 0) {
+			clear();
+		}
+	}
+
+	void append(std::span<const std::uint8_t> data) {
+		while (!data.empty()) {
+			if (m_links.empty() || m_links.back().end == m_links.back().capacity) {
+				m_links.push_back(newChunk());
+			}
+			Link& tail = m_links.back();
+			std::size_t n = std::min(data.size(), tail.capacity - tail.end);
+			std::memcpy(tail.data + tail.end, data.data(), n);
+			tail.end += n;
+			m_size += n;
+			data = data.subspan(n);
+		}
+	}
+
+	/*
+	 * 把所有数据合并到第一段，并保证第一段的容量至少为capacity
+	 * 解析器报告需要更多数据且知道需要多少(帧长度、Content-Length)时调用，之后读到的数据直接进这一段
+	 */
+	void pullup(std::size_t capacity) {
+		capacity = std::max(capacity, m_size);
+		if (m_links.size() <= 1 && frontCapacity() >= capacity) {
+			return;
+		}
+		Link merged = capacity <= BufferPool::kChunkSize ? newChunk() : newBlock(capacity);
+		for (Link& link : m_links) {
+			std::memcpy(merged.data + merged.end, link.data + link.begin, link.end - link.begin);
+			merged.end += link.end - link.begin;
+			freeLink(link);
+		}
+		m_links.clear();
+		m_links.push_back(merged);
+	}
+
+	/*
+	 * 一次readv读入尾段的空位和栈上64KB的溢出区，一次系统调用基本能把socket读空
+	 * 溢出区的数据再拷进新链上的块；返回read的结果，出错时errno有效
+	 */
+	ssize_t readFd(int fd) {
+		std::uint8_t spill[kSpillSize];
+		bool added = false;
+		if (m_links.empty() || m_links.back().end == m_links.back().capacity) {
+			m_links.push_back(newChunk());
+			added = true;
+		}
+		Link& tail = m_links.back();
+		std::size_t room = tail.capacity - tail.end;
+		iovec iov[2] = {
+			{tail.data + tail.end, room},
+			{spill, sizeof(spill)}
+		};
+		ssize_t n = ::readv(fd, iov, 2);
+		if (n <= 0) {
+			if (added) {
+				int saved = errno;
+				freeLink(m_links.back());
+				m_links.pop_back();
+				errno = saved;
+			}
+			return n;
+		}
+		std::size_t got = static_cast<std::size_t>(n);
+		std::size_t direct = std::min(got, room);
+		tail.end += direct;
+		m_size += direct;
+		if (got > direct) {
+			append({spill, got - direct});
+		}
+		return n;
+	}
+
+	void clear() {
+		for (Link& link : m_links) {
+			freeLink(link);
+		}
+		m_links.clear();
+		m_size = 0;
+	}
+
+private:
+	struct Link {
+		std::uint8_t* data;
+		std::size_t capacity;
+		std::size_t begin;
+		std::size_t end;
+	};
+
+	static Link newChunk() {
+		return Link{BufferPool::local().acquire(), BufferPool::kChunkSize, 0, 0};
+	}
+
+	static Link newBlock(std::size_t capacity) {
+		return Link{static_cast<std::uint8_t*>(::operator new(capacity)), capacity, 0, 0};
+	}
+
+	// 容量等于块大小的都是池里的块
+	static void freeLink(Link& link) {
+		if (link.capacity == BufferPool::kChunkSize) {
+			BufferPool::local().release(link.data);
+		} else {
+			::operator delete(link.data);
+		}
+		link.data = nullptr;
+	}
+
+	std::vector<Link> m_links;
+	std::size_t m_size = 0;
+};
@@ -0,0 +1,119 @@
+/*
+ * Chase-Lev无锁双端队列(按Lê等人的C11内存序版本实现)
+ * 只有所属线程可以push/pop(从bottom端，LIFO)，其他线程只能steal(从top端，FIFO)
+ * T需为可平凡复制的小对象，一般存指针
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+template <typename T>
+class chase_lev_deque
+{
+    static_assert(std::is_trivially_copyable_v<T>, "chase_lev_deque stores T in atomics");
+
+public:
+    explicit chase_lev_deque(std::size_t capacity = 1024)
+    {
+        std::size_t cap = 1;
+        while (cap < capacity) cap <<= 1;
+        m_arrays.push_back(std::make_unique<ring>(cap));
+        m_array.store(m_arrays.back().get(), std::memory_order_relaxed);
+    }
+
+    chase_lev_deque(const chase_lev_deque&) = delete;
+    chase_lev_deque& operator=(const chase_lev_deque&) = delete;
+
+    // 仅所属线程调用
+    void push(T item)
+    {
+        std::int64_t b = m_bottom.load(std::memory_order_relaxed);
+        std::int64_t t = m_top.load(std::memory_order_acquire);
+        ring* a = m_array.load(std::memory_order_relaxed);
+        if (b - t > static_cast<std::int64_t>(a->mask)) a = grow_(a, t, b);
+        a->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // 仅所属线程调用
+    std::optional<T> pop()
+    {
+        std::int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+        ring* a = m_array.load(std::memory_order_relaxed);
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t t = m_top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        T item = a->get(b);
+        if (t == b) {
+            // 只剩最后一个，和steal竞争
+            bool won = m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            if (!won) return std::nullopt;
+        }
+        return item;
+    }
+
+    // 任意线程调用，竞争失败时也返回nullopt
+    std::optional<T> steal()
+    {
+        std::int64_t t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t b = m_bottom.load(std::memory_order_acquire);
+        if (t >= b) return std::nullopt;
+
+        ring* a = m_array.load(std::memory_order_consume);
+        T item = a->get(t);
+        if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return std::nullopt;
+        return item;
+    }
+
+    bool empty() const noexcept
+    {
+        return m_bottom.load(std::memory_order_relaxed) <= m_top.load(std::memory_order_relaxed);
+    }
+
+    std::size_t size() const noexcept
+    {
+        std::int64_t n = m_bottom.load(std::memory_order_relaxed) - m_top.load(std::memory_order_relaxed);
+        return n > 0 ? static_cast<std::size_t>(n) : 0;
+    }
+
+private:
+    struct ring {
+        explicit ring(std::size_t cap) : mask{cap - 1}, slots{new std::atomic<T>[cap]} {}
+
+        T get(std::int64_t i) const noexcept { return slots[i & mask].load(std::memory_order_relaxed); }
+        void put(std::int64_t i, T v) noexcept { slots[i & mask].store(v, std::memory_order_relaxed); }
+
+        std::size_t mask;
+        std::unique_ptr<std::atomic<T>[]> slots;
+    };
+
+    // 旧数组可能仍被steal读取，保留到析构时再释放
+    ring* grow_(ring* old, std::int64_t t, std::int64_t b)
+    {
+        m_arrays.push_back(std::make_unique<ring>((old->mask + 1) * 2));
+        ring* a = m_arrays.back().get();
+        for (std::int64_t i = t; i < b; ++i) a->put(i, old->get(i));
+        m_array.store(a, std::memory_order_release);
+        return a;
+    }
+
+    alignas(64) std::atomic<std::int64_t> m_top{0};
+    alignas(64) std::atomic<std::int64_t> m_bottom{0};
+    alignas(64) std::atomic<ring*> m_array{nullptr};
+    std::vector<std::unique_ptr<ring>> m_arrays;   // 只有所属线程修改
+};
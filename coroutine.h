@@ -0,0 +1,406 @@
+/*
+ * C++20协程层：Task<T> + 基于EventLoop的awaitable
+ *   co_await readable(fd) / writable(fd)   fd就绪后在reactor线程内联恢复
+ *   co_await sleep_for(ms)                 由loop的定时器驱动
+ *   co_await resume_on(pool)               切到ThreadPool的worker上继续执行
+ *   co_await resume_on(loop)               切回reactor线程
+ * 连接的状态直接放在协程帧里，例如：
+ *   Task<> session(AsyncFd conn) { while (true) { co_await conn.readable(); ... } }
+ *   co_spawn(session(AsyncFd{loop, fd}));
+ * 协程帧从线程局部的按大小分级的空闲链表分配，新建连接不需要malloc
+ */
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <new>
+#include <optional>
+#include <utility>
+#include <assert.h>
+
+#include "event_loop.h"
+#include "thread_pool.h"
+
+namespace detail {
+
+struct frame_node { frame_node* next; };
+
+struct frame_free_list
+{
+    frame_node* head = nullptr;
+    std::size_t count = 0;
+
+    ~frame_free_list()
+    {
+        while (head) {
+            frame_node* next = head->next;
+            ::operator delete(head);
+            head = next;
+        }
+    }
+};
+
+} // namespace detail
+
+class frame_pool
+{
+public:
+    static void* allocate(std::size_t n)
+    {
+        std::size_t cls = class_of_(n);
+        if (cls >= kClassCount) return ::operator new(n);
+        auto& list = t_free[cls];
+        if (list.head) {
+            node* p = list.head;
+            list.head = p->next;
+            --list.count;
+            return p;
+        }
+        return ::operator new((cls + 1) * kGranularity);
+    }
+
+    // 帧可能在另一个线程上销毁，此时归还到那个线程的空闲链表
+    static void deallocate(void* p, std::size_t n) noexcept
+    {
+        std::size_t cls = class_of_(n);
+        if (cls >= kClassCount) {
+            ::operator delete(p);
+            return;
+        }
+        auto& list = t_free[cls];
+        if (list.count >= kMaxCachedPerClass) {
+            ::operator delete(p);
+            return;
+        }
+        list.head = ::new (p) node{list.head};
+        ++list.count;
+    }
+
+private:
+    static constexpr std::size_t kGranularity = 64;
+    static constexpr std::size_t kClassCount = 32;          // 最大缓存2KB的帧
+    static constexpr std::size_t kMaxCachedPerClass = 4096;
+
+    using node = detail::frame_node;
+
+    static std::size_t class_of_(std::size_t n) noexcept { return (n + kGranularity - 1) / kGranularity - 1; }
+
+    static inline thread_local detail::frame_free_list t_free[kClassCount];
+};
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+struct promise_base
+{
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+    bool detached = false;
+
+    struct final_awaiter
+    {
+        bool await_ready() noexcept { return false; }
+
+        template <typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+        {
+            auto& p = h.promise();
+            if (p.continuation) return p.continuation;
+            if (p.detached) h.destroy();
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    final_awaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() noexcept
+    {
+        // 与std::thread一致，没人等待的协程抛出异常直接终止
+        if (detached) std::terminate();
+        exception = std::current_exception();
+    }
+
+    static void* operator new(std::size_t n) { return frame_pool::allocate(n); }
+    static void operator delete(void* p, std::size_t n) noexcept { frame_pool::deallocate(p, n); }
+};
+
+template <typename T>
+struct promise : promise_base
+{
+    std::optional<T> value;
+
+    Task<T> get_return_object() noexcept;
+
+    template <typename U>
+    void return_value(U&& v) { value.emplace(std::forward<U>(v)); }
+
+    T result()
+    {
+        if (exception) std::rethrow_exception(exception);
+        return std::move(*value);
+    }
+};
+
+template <>
+struct promise<void> : promise_base
+{
+    Task<void> get_return_object() noexcept;
+
+    void return_void() noexcept {}
+
+    void result()
+    {
+        if (exception) std::rethrow_exception(exception);
+    }
+};
+
+} // namespace detail
+
+// 惰性启动：被co_await或co_spawn时才开始执行
+template <typename T>
+class [[nodiscard]] Task
+{
+public:
+    using promise_type = detail::promise<T>;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    Task() noexcept = default;
+    explicit Task(handle_type h) noexcept : m_handle{h} {}
+    Task(Task&& other) noexcept : m_handle{std::exchange(other.m_handle, {})} {}
+
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this != &other) {
+            if (m_handle) m_handle.destroy();
+            m_handle = std::exchange(other.m_handle, {});
+        }
+        return *this;
+    }
+
+    ~Task()
+    {
+        if (m_handle) m_handle.destroy();
+    }
+
+    bool done() const noexcept { return !m_handle || m_handle.done(); }
+
+    // 被移走或已detach的Task不能co_await
+    auto operator co_await() && noexcept
+    {
+        assert(m_handle);
+        struct awaiter
+        {
+            handle_type h;
+            bool await_ready() noexcept { return h.done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> cont) noexcept
+            {
+                h.promise().continuation = cont;
+                return h;
+            }
+            T await_resume() { return h.promise().result(); }
+        };
+        return awaiter{m_handle};
+    }
+
+    // 交出所有权并开始执行，协程结束后自行销毁
+    void detach() &&
+    {
+        handle_type h = std::exchange(m_handle, {});
+        h.promise().detached = true;
+        h.resume();
+    }
+
+private:
+    handle_type m_handle;
+};
+
+namespace detail {
+
+template <typename T>
+Task<T> promise<T>::get_return_object() noexcept
+{
+    return Task<T>{std::coroutine_handle<promise<T>>::from_promise(*this)};
+}
+
+inline Task<void> promise<void>::get_return_object() noexcept
+{
+    return Task<void>{std::coroutine_handle<promise<void>>::from_promise(*this)};
+}
+
+// 一次性监听：挂起时注册，就绪后注销并在reactor线程上恢复
+struct fd_awaiter
+{
+    EventLoop* loop;
+    int fd;
+    uint32_t events;
+    uint32_t revents = 0;
+    EventLoop::ChannelHandle channel = EventLoop::kInvalidChannel;
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        loop->RunInLoop([this, h] {
+            channel = loop->AddFd(fd, events | EPOLLONESHOT, [this, h](uint32_t ev) {
+                loop->DelFd(channel);
+                revents = ev;
+                h.resume();
+            });
+            if (channel == EventLoop::kInvalidChannel) {
+                revents = EPOLLERR;
+                h.resume();
+            }
+        });
+    }
+
+    // 返回就绪事件，EPOLLERR/EPOLLHUP时由调用方处理
+    uint32_t await_resume() const noexcept { return revents; }
+};
+
+} // namespace detail
+
+inline void co_spawn(Task<void> task)
+{
+    std::move(task).detach();
+}
+
+inline auto readable(int fd, EventLoop* loop = EventLoop::Current())
+{
+    assert(loop != nullptr);
+    return detail::fd_awaiter{loop, fd, EPOLLIN | EPOLLRDHUP};
+}
+
+inline auto writable(int fd, EventLoop* loop = EventLoop::Current())
+{
+    assert(loop != nullptr);
+    return detail::fd_awaiter{loop, fd, EPOLLOUT};
+}
+
+inline auto sleep_for(int ms, EventLoop* loop = EventLoop::Current())
+{
+    assert(loop != nullptr);
+    struct awaiter
+    {
+        EventLoop* loop;
+        int ms;
+        bool await_ready() const noexcept { return ms <= 0; }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            loop->RunInLoop([loop = loop, ms = ms, h] {
+                // 不在定时器的tick里直接恢复，协程可能会再添加定时器
+                loop->RunAfter(ms, [loop, h] { loop->QueueInLoop([h] { h.resume(); }); });
+            });
+        }
+        void await_resume() const noexcept {}
+    };
+    return awaiter{loop, ms};
+}
+
+inline auto resume_on(ThreadPool& pool)
+{
+    struct awaiter
+    {
+        ThreadPool& pool;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) { pool.add_task([h] { h.resume(); }); }
+        void await_resume() const noexcept {}
+    };
+    return awaiter{pool};
+}
+
+inline auto resume_on(EventLoop& loop)
+{
+    struct awaiter
+    {
+        EventLoop& loop;
+        bool await_ready() const noexcept { return loop.IsInLoopThread(); }
+        void await_suspend(std::coroutine_handle<> h) { loop.QueueInLoop([h] { h.resume(); }); }
+        void await_resume() const noexcept {}
+    };
+    return awaiter{loop};
+}
+
+/*
+ * 长连接用：fd只注册一次(边沿触发)，之后的readable()/writable()不再有epoll_ctl
+ * 就绪早于co_await到达时记在标志位里，不会丢失边沿；须在loop线程中构造和使用
+ */
+class AsyncFd
+{
+public:
+    AsyncFd(EventLoop& loop, int fd) : m_state{std::make_unique<State>()}
+    {
+        m_state->loop = &loop;
+        m_state->fd = fd;
+        State* st = m_state.get();
+        m_state->channel = loop.AddFd(fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, [st](uint32_t ev) {
+            // 先取出等待者再恢复，恢复后的协程可能析构AsyncFd
+            std::coroutine_handle<> r, w;
+            if (ev & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) r = st->take(st->reader, st->readReady);
+            if (ev & (EPOLLOUT | EPOLLERR | EPOLLHUP)) w = st->take(st->writer, st->writeReady);
+            if (r) r.resume();
+            if (w) w.resume();
+        });
+    }
+
+    AsyncFd(AsyncFd&&) noexcept = default;
+
+    // 先注销自己原来的fd，否则State释放后channel回调还会用到它
+    AsyncFd& operator=(AsyncFd&& other) noexcept
+    {
+        if (this != &other) {
+            if (m_state) m_state->loop->DelFd(m_state->channel);
+            m_state = std::move(other.m_state);
+        }
+        return *this;
+    }
+
+    // 只注销，不关闭fd
+    ~AsyncFd()
+    {
+        if (m_state) m_state->loop->DelFd(m_state->channel);
+    }
+
+    int fd() const noexcept { return m_state->fd; }
+    bool valid() const noexcept { return m_state && m_state->channel != EventLoop::kInvalidChannel; }
+
+    auto readable() noexcept { return awaiter{m_state.get(), &State::reader, &State::readReady}; }
+    auto writable() noexcept { return awaiter{m_state.get(), &State::writer, &State::writeReady}; }
+
+private:
+    struct State
+    {
+        EventLoop* loop = nullptr;
+        int fd = -1;
+        EventLoop::ChannelHandle channel = EventLoop::kInvalidChannel;
+        std::coroutine_handle<> reader;
+        std::coroutine_handle<> writer;
+        bool readReady = false;
+        bool writeReady = false;
+
+        std::coroutine_handle<> take(std::coroutine_handle<>& waiter, bool& ready) noexcept
+        {
+            if (!waiter) ready = true;
+            return std::exchange(waiter, {});
+        }
+    };
+
+    struct awaiter
+    {
+        State* st;
+        std::coroutine_handle<> State::*waiter;
+        bool State::*ready;
+
+        bool await_ready() const noexcept { return std::exchange(st->*ready, false); }
+        void await_suspend(std::coroutine_handle<> h) noexcept { st->*waiter = h; }
+        void await_resume() const noexcept {}
+    };
+
+    std::unique_ptr<State> m_state;
+};
@@ -33,9 +33,26 @@ public:
         return epoll_ctl(m_epollFd, EPOLL_CTL_MOD, fd, &ev) == 0;
     }
 
+    // data.u64携带调用方的handle(如Slab::Handle)，就绪时用GetEventData取回，省去fd到连接的查找
+    bool AddFd(int fd, uint32_t events, uint64_t data) {
+        if (fd < 0) return false;
+        epoll_event ev{};
+        ev.data.u64 = data;
+        ev.events = events;
+        return epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev) == 0;
+    }
+
+    bool ModFd(int fd, uint32_t events, uint64_t data) {
+        if (fd < 0) return false;
+        epoll_event ev{};
+        ev.data.u64 = data;
+        ev.events = events;
+        return epoll_ctl(m_epollFd, EPOLL_CTL_MOD, fd, &ev) == 0;
+    }
+
     bool DelFd(int fd) {
         if (fd < 0) return false;
-        epoll_event ev{0};
+        epoll_event ev{};
         return epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, &ev) == 0;
     }
 
@@ -48,6 +65,11 @@ public:
         return m_events[i].data.fd;
     }
 
+    uint64_t GetEventData(size_t i) const {
+        assert(i < m_events.size());
+        return m_events[i].data.u64;
+    }
+
     uint32_t GetEvents(size_t i) const {
         assert(i < m_events.size());
         return m_events[i].events;
@@ -0,0 +1,282 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <assert.h>
+
+#include "poller.h"
+#include "timing_wheel.h"
+#include "slab.h"
+
+/*
+ * one loop per thread：每个EventLoop独占一个Poller(epoll或io_uring)和一个定时器(分层时间轮)，
+ * 只在所属线程里分发事件；其他线程只能通过RunInLoop/QueueInLoop投递任务
+ */
+class EventLoop {
+public:
+    using EventCallback = std::function<void(uint32_t events)>;
+    using CompletionCallback = std::function<void(const UringCompletion&)>;
+    using Functor = std::function<void()>;
+    using ChannelHandle = std::uint64_t;
+    static constexpr ChannelHandle kInvalidChannel = 0;
+    // 接口与HeapTimer一致；空闲连接超时大多会被推迟或取消，时间轮的增删改都是O(1)
+    using LoopTimer = TimingWheel;
+
+    explicit EventLoop(int maxEvent = 1024, PollerBackend backend = PollerBackend::Epoll)
+        : m_poller{backend, maxEvent},
+          m_wakeupFd{eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)},
+          m_threadId{std::this_thread::get_id()}
+    {
+        assert(m_wakeupFd >= 0);
+        if (t_loop == nullptr) t_loop = this;
+        m_poller.AddFd(m_wakeupFd, EPOLLIN, kInvalidChannel);
+    }
+
+    ~EventLoop() {
+        if (m_timerFd >= 0) {
+            m_poller.DelFd(m_timerFd);
+            close(m_timerFd);
+        }
+        m_poller.DelFd(m_wakeupFd);
+        close(m_wakeupFd);
+        if (t_loop == this) t_loop = nullptr;
+    }
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // 只能在所属线程调用
+    void Loop() {
+        m_threadId = std::this_thread::get_id();
+        t_loop = this;
+        while (!m_quit.load(std::memory_order_acquire)) {
+            int timeoutMs = m_timer.GetNextTick();
+            if (m_timerFd >= 0) {
+                ArmTimerFd_(timeoutMs);
+                timeoutMs = -1;
+            }
+            int n = m_poller.Wait(timeoutMs);
+            m_timer.UpdateClock();   // 本轮回调里添加的定时器都基于这个时间
+            m_eventHandling = true;
+            for (int i = 0; i < n; ++i) {
+                ChannelHandle h = m_poller.GetEventData(i);
+                if (h == kInvalidChannel) {
+                    HandleWakeup_();
+                    continue;
+                }
+                if (h == kTimerChannel) {
+                    HandleTimerFd_();
+                    continue;
+                }
+                // 本批次中已被DelFd的channel(包括fd已被复用的情况)在这里被过滤掉
+                Channel* ch = m_channels.get(h);
+                if (ch == nullptr) continue;
+                if (!m_poller.IsCompletion(i)) ch->cb(m_poller.GetEvents(i));
+                else if (ch->onCompletion) ch->onCompletion(m_poller.Uring()->GetCompletion(i));
+            }
+            m_eventHandling = false;
+            m_channels.collect();
+            m_freeTimerIds.insert(m_freeTimerIds.end(), m_retiredTimerIds.begin(), m_retiredTimerIds.end());
+            m_retiredTimerIds.clear();
+            DoPendingFunctors_();
+        }
+        // 退出前投递进来的任务(比如转交过来的新连接)还要执行一次，否则其中的资源会泄漏
+        DoPendingFunctors_();
+    }
+
+    // 可跨线程调用
+    void Quit() {
+        m_quit.store(true, std::memory_order_release);
+        // 在定时器回调里调用时loop接下来会进入Wait，同样需要唤醒
+        if (!IsInLoopThread() || !m_eventHandling) Wakeup();
+    }
+
+    bool IsInLoopThread() const noexcept {
+        return m_threadId == std::this_thread::get_id();
+    }
+
+    void RunInLoop(Functor cb) {
+        if (IsInLoopThread()) cb();
+        else QueueInLoop(std::move(cb));
+    }
+
+    void QueueInLoop(Functor cb) {
+        {
+            std::lock_guard lock{m_mutex};
+            m_pendingFunctors.push_back(std::move(cb));
+        }
+        // 只有在事件分发阶段投递的任务能赶上本轮执行，其余情况(包括定时器回调)都要唤醒
+        if (!IsInLoopThread() || !m_eventHandling) Wakeup();
+    }
+
+    // 以下fd操作只能在所属线程调用，失败返回kInvalidChannel
+    ChannelHandle AddFd(int fd, uint32_t events, EventCallback cb) {
+        return AddFd(fd, events, std::move(cb), {});
+    }
+
+    // 就绪通知交给cb；io_uring后端下该fd上Uring()->Prep*请求的完成事件交给onCompletion
+    ChannelHandle AddFd(int fd, uint32_t events, EventCallback cb, CompletionCallback onCompletion) {
+        assert(IsInLoopThread());
+        ChannelHandle h = m_channels.emplace(Channel{fd, std::move(cb), std::move(onCompletion)});
+        if (!m_poller.AddFd(fd, events, h)) {
+            m_channels.erase(h);
+            return kInvalidChannel;
+        }
+        return h;
+    }
+
+    bool ModFd(ChannelHandle h, uint32_t events) {
+        assert(IsInLoopThread());
+        Channel* ch = m_channels.get(h);
+        return ch != nullptr && m_poller.ModFd(ch->fd, events, h);
+    }
+
+    bool DelFd(ChannelHandle h) {
+        assert(IsInLoopThread());
+        Channel* ch = m_channels.get(h);
+        if (ch == nullptr) return false;
+        bool ok = m_poller.DelFd(ch->fd);
+        // 回调可能正在执行，推迟到本轮分发结束再析构
+        m_channels.release(h);
+        return ok;
+    }
+
+    // 仅io_uring后端：登记一个不做就绪监听的channel，返回的handle用于Uring()->Prep*，
+    // 完成事件交给cb；用DelFd注销时会取消该fd上未完成的请求
+    ChannelHandle AddCompletionFd(int fd, CompletionCallback cb) {
+        assert(IsInLoopThread());
+        if (m_poller.Uring() == nullptr) return kInvalidChannel;
+        return m_channels.emplace(Channel{fd, {}, std::move(cb)});
+    }
+
+    // 一次性定时器，id由loop分配(负数，不与以fd为id的连接定时器冲突)
+    int RunAfter(int timeoutMs, TimeoutCallBack cb) {
+        assert(IsInLoopThread());
+        int id;
+        if (!m_freeTimerIds.empty()) {
+            id = m_freeTimerIds.back();
+            m_freeTimerIds.pop_back();
+        } else {
+            id = --m_lastTimerId;
+        }
+        m_timer.add(id, timeoutMs, [this, id, cb = std::move(cb)] {
+            // 回调执行期间id仍可能被定时器引用，要等到本轮结束再复用
+            m_retiredTimerIds.push_back(id);
+            cb();
+        });
+        return id;
+    }
+
+    /*
+     * 改由timerfd驱动定时器：Wait不再带超时，timerfd只在最早的到期时间变化时重新设置
+     * slackMs>0时把触发时刻向上取整到slackMs的整数倍，相近的定时器合并到同一次唤醒里处理，
+     * 代价是定时器最多晚slackMs毫秒触发。只能在所属线程调用
+     */
+    bool EnableTimerFd(int slackMs = 0) {
+        assert(IsInLoopThread());
+        m_timerSlackNs = slackMs > 0 ? static_cast<int64_t>(slackMs) * 1000000 : 0;
+        if (m_timerFd >= 0) return true;
+        m_timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (m_timerFd < 0) return false;
+        if (!m_poller.AddFd(m_timerFd, EPOLLIN | EPOLLET, kTimerChannel)) {
+            close(m_timerFd);
+            m_timerFd = -1;
+            return false;
+        }
+        return true;
+    }
+
+    LoopTimer& GetTimer() noexcept { return m_timer; }
+    Poller& GetPoller() noexcept { return m_poller; }
+
+    // 当前线程正在运行的loop，不在loop线程中时为nullptr
+    static EventLoop* Current() noexcept { return t_loop; }
+
+    void Wakeup() {
+        uint64_t one = 1;
+        ssize_t n = write(m_wakeupFd, &one, sizeof(one));
+        (void)n;
+    }
+
+private:
+    struct Channel {
+        int fd;
+        EventCallback cb;
+        CompletionCallback onCompletion;
+    };
+
+    void HandleWakeup_() {
+        uint64_t one;
+        ssize_t n = read(m_wakeupFd, &one, sizeof(one));
+        (void)n;
+    }
+
+    void HandleTimerFd_() {
+        uint64_t expirations;
+        // 重新设置时间前已就绪的事件可能晚到，此时read返回EAGAIN，不算到期
+        if (read(m_timerFd, &expirations, sizeof(expirations)) != sizeof(expirations)) return;
+        m_timerArmedNs = 0;
+        m_timer.tick();
+    }
+
+    // timeoutMs为GetNextTick的返回值，-1表示没有定时器
+    void ArmTimerFd_(int timeoutMs) {
+        int64_t deadline = 0;
+        if (timeoutMs >= 0) {
+            auto now = std::chrono::steady_clock::now().time_since_epoch();
+            deadline = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count() + static_cast<int64_t>(timeoutMs) * 1000000;
+            if (m_timerSlackNs > 0) deadline = (deadline + m_timerSlackNs - 1) / m_timerSlackNs * m_timerSlackNs;
+        }
+        if (deadline == m_timerArmedNs) return;
+        m_timerArmedNs = deadline;
+        itimerspec spec{};
+        spec.it_value.tv_sec = deadline / 1000000000;
+        spec.it_value.tv_nsec = deadline % 1000000000;
+        // it_value全为0时停止计时
+        timerfd_settime(m_timerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+    }
+
+    void DoPendingFunctors_() {
+        std::vector<Functor> functors;
+        {
+            std::lock_guard lock{m_mutex};
+            functors.swap(m_pendingFunctors);
+        }
+        for (auto& f : functors) f();
+    }
+
+    Poller m_poller;
+    LoopTimer m_timer;
+    int m_wakeupFd;
+    std::thread::id m_threadId;
+    std::atomic<bool> m_quit{false};
+    bool m_eventHandling = false;
+
+    std::mutex m_mutex;
+    std::vector<Functor> m_pendingFunctors;
+
+    Slab<Channel> m_channels;
+
+    int m_lastTimerId = 0;
+    std::vector<int> m_freeTimerIds;
+    std::vector<int> m_retiredTimerIds;
+
+    // timerfd在poller里的data，slab的下标到不了2^32-1，不会与channel冲突
+    static constexpr ChannelHandle kTimerChannel = ~ChannelHandle{0};
+    int m_timerFd = -1;
+    int64_t m_timerSlackNs = 0;
+    int64_t m_timerArmedNs = 0;   // 已设置的绝对触发时刻(CLOCK_MONOTONIC)，0表示未设置
+
+    static inline thread_local EventLoop* t_loop = nullptr;
+};
+
+#endif //EVENT_LOOP_H
@@ -1,148 +1,124 @@
-/******************************************************************************
+#include "heaptimer.h"
 
-                              Online C++ Compiler.
-               Code, Compile, Run and Debug C++ program online.
-Write your code in this editor and press "Run" button to compile and execute it.
+#include <utility>
 
-*******************************************************************************/
-#include <queue>
-#include <unordered_map>
-#include <algorithm>
-#include <functional>
-#include <chrono>
-#include <vector>
-#include <assert.h>
-
-using TimeoutCallBack = std::function<void()>;
-using TimeStamp = std::chrono::time_point<std::chrono::system_clock>;
-using MS = std::chrono::milliseconds;
-
-struct TimerNode {
-    int m_id;
-    TimeStamp m_expires;        // 设置过期时间
-    TimeoutCallBack m_cb;       // 回调函数
-    bool operator<(const TimerNode& t) const noexcept { return m_expires < t.m_expires; }
-};
-
-class HeapTimer {
-public:
-    HeapTimer() noexcept = default;
-    ~HeapTimer() noexcept { clear(); }
-
-    void adjust(int id, int newExpires) noexcept;
-    void add(int id, int timeOut, const TimeoutCallBack& cb) noexcept;
-    void doWork(int id) noexcept;
-    void clear() noexcept;
-    void tick() noexcept;
-    int GetNextTick() noexcept;
-
-private:
-    void del_(size_t i) noexcept;
-    void pop() noexcept;
-    void siftup_(size_t i) noexcept;
-    bool siftdown_(size_t index, size_t n) noexcept;
-    void SwapNode_(size_t i, size_t j) noexcept;
+void HeapTimer::UpdateClock() noexcept {
+    m_now = std::chrono::duration_cast<MS>(std::chrono::steady_clock::now() - m_start).count();
+}
 
-    std::vector<TimerNode> m_heap;
-    std::unordered_map<int, size_t> m_ref;
-};
+void HeapTimer::place_(size_t i, std::int64_t deadline, int id) noexcept {
+    m_deadlines[i] = deadline;
+    m_ids[i] = id;
+    m_pos[index_(id)] = static_cast<std::int32_t>(i);
+}
 
+// 空穴式上浮：先记下要移动的节点，父节点依次下移，最后一次写入
 void HeapTimer::siftup_(size_t i) noexcept {
-    size_t j = (i - 1) / 2;
-    while(j >= 0 && m_heap[j] < m_heap[i]) {
-        SwapNode_(i, j);
-        i = j;
-        j = (i - 1) / 2;
+    std::int64_t deadline = m_deadlines[i];
+    int id = m_ids[i];
+    while(i > 0) {
+        size_t parent = (i - 1) / kArity;
+        if(m_deadlines[parent] <= deadline) break;
+        place_(i, m_deadlines[parent], m_ids[parent]);
+        i = parent;
     }
+    place_(i, deadline, id);
 }
 
-void HeapTimer::SwapNode_(size_t i, size_t j) noexcept {
-    std::swap(m_heap[i], m_heap[j]);
-    m_ref[m_heap[i].m_id] = i;
-    m_ref[m_heap[j].m_id] = j;
-}
-
-bool HeapTimer::siftdown_(size_t index, size_t n) noexcept {
+bool HeapTimer::siftdown_(size_t index) noexcept {
+    size_t n = m_deadlines.size();
     size_t i = index;
-    size_t j = i * 2 + 1;
-    while(j < n) {
-        if(j + 1 < n && m_heap[j + 1] < m_heap[j]) j++;
-        if(m_heap[i] < m_heap[j]) break;
-        SwapNode_(i, j);
-        i = j;
-        j = i * 2 + 1;
+    std::int64_t deadline = m_deadlines[i];
+    int id = m_ids[i];
+    while(true) {
+        size_t first = i * kArity + 1;
+        if(first >= n) break;
+        size_t last = std::min(first + kArity, n);
+        size_t child = first;
+        for(size_t j = first + 1; j < last; j++) {
+            if(m_deadlines[j] < m_deadlines[child]) child = j;
+        }
+        if(deadline <= m_deadlines[child]) break;
+        place_(i, m_deadlines[child], m_ids[child]);
+        i = child;
     }
+    place_(i, deadline, id);
     return i > index;
 }
 
 void HeapTimer::add(int id, int timeout, const TimeoutCallBack& cb) noexcept {
-    size_t i;
-    if(m_ref.count(id) == 0) {
-        i = m_heap.size();
-        m_ref[id] = i;
-        m_heap.push_back({id, std::chrono::system_clock::now() + MS(timeout), cb});
-        siftup_(i);
+    std::uint32_t k = index_(id);
+    if(k >= m_pos.size()) {
+        m_pos.resize(k + 1, kNpos);
+        m_callbacks.resize(k + 1);
+    }
+    m_callbacks[k] = cb;
+    std::int64_t deadline = m_now + timeout;
+    if(m_pos[k] == kNpos) {
+        m_deadlines.push_back(deadline);
+        m_ids.push_back(id);
+        siftup_(m_deadlines.size() - 1);
     } else {
-        i = m_ref[id];
-        m_heap[i].m_expires = std::chrono::system_clock::now() + MS(timeout);
-        m_heap[i].m_cb = cb;
-        if(!siftdown_(i, m_heap.size())) {
-            siftup_(i);
-        }
+        size_t i = m_pos[k];
+        m_deadlines[i] = deadline;
+        if(!siftdown_(i)) siftup_(i);
     }
 }
 
 void HeapTimer::doWork(int id) noexcept {
-    if(m_heap.empty() || m_ref.count(id) == 0) return;
-    size_t i = m_ref[id];
-    TimerNode node = m_heap[i];
-    node.m_cb();
-    del_(i);
+    std::uint32_t k = index_(id);
+    if(k >= m_pos.size() || m_pos[k] == kNpos) return;
+    // 先删除再回调，回调里可以重新添加同一个id
+    TimeoutCallBack cb = std::move(m_callbacks[k]);
+    del_(m_pos[k]);
+    if(cb) cb();
 }
 
 void HeapTimer::del_(size_t index) noexcept {
-    size_t i = index;
-    size_t n = m_heap.size() - 1;
-    if(i < n) {
-        SwapNode_(i, n);
-        if(!siftdown_(i, n)) {
-            siftup_(i);
-        }
+    size_t n = m_deadlines.size() - 1;
+    m_pos[index_(m_ids[index])] = kNpos;
+    if(index < n) {
+        place_(index, m_deadlines[n], m_ids[n]);
+        m_deadlines.pop_back();
+        m_ids.pop_back();
+        if(!siftdown_(index)) siftup_(index);
+    } else {
+        m_deadlines.pop_back();
+        m_ids.pop_back();
     }
-    m_ref.erase(m_heap.back().m_id);
-    m_heap.pop_back();
 }
 
 void HeapTimer::adjust(int id, int timeout) noexcept {
-    m_heap[m_ref[id]].m_expires = std::chrono::system_clock::now() + MS(timeout);
-    siftdown_(m_ref[id], m_heap.size());
-}
-
-void HeapTimer::pop() noexcept {
-    assert(!m_heap.empty());
-    del_(0);
+    std::uint32_t k = index_(id);
+    if(k >= m_pos.size() || m_pos[k] == kNpos) return;
+    size_t i = m_pos[k];
+    m_deadlines[i] = m_now + timeout;
+    if(!siftdown_(i)) siftup_(i);
 }
 
 void HeapTimer::tick() noexcept {
-    if(m_heap.empty()) return;
-    while(!m_heap.empty()) {
-        TimerNode node = m_heap.front();
-        if(std::chrono::duration_cast<MS>(node.m_expires - std::chrono::system_clock::now()).count() > 0) {
-            break;
-        }
-        node.m_cb();
-        pop();
+    UpdateClock();
+    while(!m_deadlines.empty() && m_deadlines.front() <= m_now) {
+        std::uint32_t k = index_(m_ids.front());
+        TimeoutCallBack cb = std::move(m_callbacks[k]);
+        del_(0);
+        if(cb) cb();
     }
 }
 
 void HeapTimer::clear() noexcept {
-    m_ref.clear();
-    m_heap.clear();
+    for(int id : m_ids) {
+        std::uint32_t k = index_(id);
+        m_pos[k] = kNpos;
+        m_callbacks[k] = nullptr;
+    }
+    m_deadlines.clear();
+    m_ids.clear();
 }
 
 int HeapTimer::GetNextTick() noexcept {
     tick();
-    if(m_heap.empty()) return -1;
-    auto duration = std::chrono::duration_cast<MS>(m_heap.front().m_expires - std::chrono::system_clock::now());
-    return duration.count() > 0 ? duration.count() : 0;
-}
\ No newline at end of file
+    if(m_deadlines.empty()) return -1;
+    std::int64_t left = m_deadlines.front() - m_now;
+    return left > 0 ? static_cast<int>(left) : 0;
+}
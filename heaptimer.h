@@ -0,0 +1,60 @@
+#ifndef HEAP_TIMER_H
+#define HEAP_TIMER_H
+
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <assert.h>
+
+using TimeoutCallBack = std::function<void()>;
+using TimeStamp = std::chrono::time_point<std::chrono::steady_clock>;
+using MS = std::chrono::milliseconds;
+
+/*
+ * 4叉最小堆定时器
+ * 堆里只存到期时间和id(两个平行数组)，回调和堆下标按id放在平铺数组里，上浮下沉时不搬动std::function
+ * 时间用单调时钟，每轮事件循环在UpdateClock/GetNextTick里读一次，add/adjust直接用缓存的时间
+ */
+class HeapTimer {
+public:
+    HeapTimer() noexcept : m_start{std::chrono::steady_clock::now()} {}
+    ~HeapTimer() noexcept { clear(); }
+
+    void adjust(int id, int newExpires) noexcept;
+    void add(int id, int timeOut, const TimeoutCallBack& cb) noexcept;
+    void doWork(int id) noexcept;
+    void clear() noexcept;
+    void tick() noexcept;
+    int GetNextTick() noexcept;
+
+    // 刷新缓存的当前时间，loop在Wait返回后调用一次
+    void UpdateClock() noexcept;
+    std::size_t size() const noexcept { return m_deadlines.size(); }
+
+private:
+    static constexpr std::size_t kArity = 4;
+    static constexpr std::int32_t kNpos = -1;
+
+    // id可能为负数(loop内部的定时器)，交错映射到非负下标
+    static std::uint32_t index_(int id) noexcept {
+        return id >= 0 ? static_cast<std::uint32_t>(id) << 1 : (static_cast<std::uint32_t>(-(id + 1)) << 1) | 1;
+    }
+
+    void del_(std::size_t i) noexcept;
+    void siftup_(std::size_t i) noexcept;
+    bool siftdown_(std::size_t i) noexcept;
+    void place_(std::size_t i, std::int64_t deadline, int id) noexcept;
+
+    TimeStamp m_start;
+    std::int64_t m_now = 0;                   // 缓存的当前时间(ms，相对m_start)
+
+    std::vector<std::int64_t> m_deadlines;    // 堆：到期时间
+    std::vector<int> m_ids;                   // 堆：与m_deadlines同下标的id
+
+    std::vector<std::int32_t> m_pos;          // index_(id) -> 堆下标，不在堆中为kNpos
+    std::vector<TimeoutCallBack> m_callbacks; // index_(id) -> 回调
+};
+
+#endif //HEAP_TIMER_H
@@ -0,0 +1,87 @@
+/*
+ * HeapTimer的基准：堆里同时有N个定时器，分三个阶段计时
+ * add：N个id依次add，超时随机分布在[0, kSpreadMs)；adjust：按随机顺序把每个id改到新的随机超时；
+ * expire：等到全部到期后一次tick，逐个弹出并执行回调。id和超时用固定种子生成，每轮相同
+ * 编译：g++ -O2 heaptimer_bench.cpp heaptimer.cpp
+ * 用法：heaptimer_bench [定时器数=1000000] [轮数=3]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "heaptimer.h"
+
+constexpr int kSpreadMs = 1000;
+
+struct Result {
+    double add;
+    double adjust;
+    double expire;
+};
+
+template <typename F>
+double time_ns_per_op(std::size_t n, F&& f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / n;
+}
+
+Result run(std::size_t n, const std::vector<int>& timeouts, const std::vector<int>& order, const std::vector<int>& adjusted)
+{
+    HeapTimer timer;
+    std::size_t fired = 0;
+    TimeoutCallBack cb = [&fired] { ++fired; };
+    Result r;
+
+    timer.UpdateClock();
+    r.add = time_ns_per_op(n, [&] {
+        for (std::size_t i = 0; i < n; ++i) timer.add(static_cast<int>(i), timeouts[i], cb);
+    });
+    timer.UpdateClock();
+    r.adjust = time_ns_per_op(n, [&] {
+        for (std::size_t i = 0; i < n; ++i) timer.adjust(order[i], adjusted[i]);
+    });
+    if (timer.size() != n) {
+        fprintf(stderr, "heap size %zu, expected %zu\n", timer.size(), n);
+        exit(1);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(kSpreadMs + 10));
+    r.expire = time_ns_per_op(n, [&] { timer.tick(); });
+    if (fired != n || timer.size() != 0) {
+        fprintf(stderr, "fired %zu of %zu\n", fired, n);
+        exit(1);
+    }
+    return r;
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 3;
+    if (n == 0) n = 1;
+
+    std::mt19937 rng{12345};
+    std::uniform_int_distribution<int> dist{0, kSpreadMs - 1};
+    std::vector<int> timeouts(n), order(n), adjusted(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        timeouts[i] = dist(rng);
+        adjusted[i] = dist(rng);
+        order[i] = static_cast<int>(i);
+    }
+    std::shuffle(order.begin(), order.end(), rng);
+
+    printf("%zu live timers, timeouts in [0, %d) ms, ns/op\n", n, kSpreadMs);
+    printf("%5s %10s %10s %10s\n", "round", "add", "adjust", "expire");
+    for (int round = 0; round < rounds; ++round) {
+        Result r = run(n, timeouts, order, adjusted);
+        printf("%5d %10.1f %10.1f %10.1f\n", round, r.add, r.adjust, r.expire);
+    }
+    return 0;
+}
@@ -0,0 +1,757 @@
+#pragma once
+
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cassert>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "buffer_pool.h"
+#include "event_loop.h"
+#include "http_parser.h"
+#include "websocket_deflate.h"
+#include "websocket_handshake.h"
+#include "websocket_message.h"
+#include "websocket_writer.h"
+
+class HttpConn;
+
+// 背压计数，多个loop线程共用
+struct HttpConnMetrics {
+	std::atomic<std::uint64_t> highWaterEvents{0};
+	std::atomic<std::uint64_t> lowWaterEvents{0};
+	std::atomic<std::int64_t> readPaused{0};		// 当前因发送积压而停止读的连接数
+};
+
+// 同一个server的所有连接共用一份，生命期要长于连接
+struct HttpConnOptions {
+	int headerTimeoutMs = 10 * 1000;		// 从请求的第一个字节到头部和body收齐
+	int idleTimeoutMs = 60 * 1000;			// keep-alive连接两次请求之间
+	int webSocketIdleTimeoutMs = 120 * 1000;
+	std::size_t maxHeaderBytes = 8 * 1024;
+	std::size_t maxBody = 1024 * 1024;
+	std::size_t maxMessage = 16 * 1024 * 1024;
+	const PerMessageDeflateConfig* deflatePolicy = nullptr;	// 为空时不协商permessage-deflate
+	// 发送队列积压到highWaterMark时停止读这个连接(撤掉EPOLLIN，也不再处理已读到的请求/消息)，
+	// 写到lowWaterMark以下时恢复；highWaterMark为0时不限制
+	std::size_t highWaterMark = 1024 * 1024;
+	std::size_t lowWaterMark = 256 * 1024;
+	HttpConnMetrics* metrics = nullptr;
+
+	// 普通请求，必须在回调里调用sendResponse；请求里的string_view只在回调期间有效
+	std::function<void(HttpConn&, const HttpRequest&)> onRequest;
+	// WebSocket升级请求，返回false时以403拒绝；为空时全部接受。没有onMessage时不接受升级
+	// 升级到其他协议(如h2c)的请求忽略Upgrade，和普通请求一样交给onRequest
+	std::function<bool(HttpConn&, const HttpRequest&)> onUpgrade;
+	std::function<void(HttpConn&)> onOpen;
+	// Text/Binary消息，payload只在回调期间有效；Ping/Close由连接自己应答
+	std::function<void(HttpConn&, const WebSocketMessage&)> onMessage;
+	std::function<void(HttpConn&)> onClose;
+	// 发送队列里积压的数据在EPOLLOUT时全部写出
+	std::function<void(HttpConn&)> onDrain;
+	// 越过高水位(已停止读)和回落到低水位(已恢复读)，回调里可以继续发送或断开连接
+	std::function<void(HttpConn&, std::size_t pendingBytes)> onHighWater;
+	std::function<void(HttpConn&, std::size_t pendingBytes)> onLowWater;
+};
+
+namespace http_conn {
+
+inline std::string_view reasonPhrase(int status) {
+	switch (status) {
+	case 101: return "Switching Protocols";
+	case 200: return "OK";
+	case 204: return "No Content";
+	case 206: return "Partial Content";
+	case 304: return "Not Modified";
+	case 400: return "Bad Request";
+	case 403: return "Forbidden";
+	case 404: return "Not Found";
+	case 405: return "Method Not Allowed";
+	case 408: return "Request Timeout";
+	case 413: return "Content Too Large";
+	case 416: return "Range Not Satisfiable";
+	case 426: return "Upgrade Required";
+	case 431: return "Request Header Fields Too Large";
+	case 500: return "Internal Server Error";
+	case 501: return "Not Implemented";
+	case 505: return "HTTP Version Not Supported";
+	default: return "Unknown";
+	}
+}
+
+// 一次sendfile最多发送的字节数，一个事件里最多调用kSendfileRounds次，大文件不会占住loop
+inline constexpr std::size_t kSendfileChunk = 1024 * 1024;
+inline constexpr int kSendfileRounds = 8;
+
+// io_uring后端每个loop一个provided buffer ring，所有连接的multishot recv共用；数据随即拷进连接的读缓冲区
+inline constexpr unsigned kRecvBuffers = 256;
+inline constexpr unsigned kRecvBufferSize = 16 * 1024;
+
+} // namespace http_conn
+
+// 共享的只读文件，最后一个引用释放时关闭；文件缓存淘汰了它时，正在进行的sendfile不受影响
+class SharedFile {
+public:
+	explicit SharedFile(int fd) : m_fd{fd} {}
+	~SharedFile() { ::close(m_fd); }
+	SharedFile(const SharedFile&) = delete;
+	SharedFile& operator=(const SharedFile&) = delete;
+
+	int fd() const { return m_fd; }
+
+private:
+	int m_fd;
+};
+
+/*
+ * 一个HTTP/1.1连接，只在所属EventLoop的线程里使用
+ * 读缓冲区里的请求原地解析，流水线上的多个请求依次交给onRequest，响应攒在发送队列里一次写出
+ * 读缓冲区是线程内池里的块链成的ChainBuffer，数据处理完块就还回池里，空闲连接不占缓冲区
+ * Upgrade成功后同一个连接、同一块读缓冲区切换到WebSocket消息解析，握手请求之后已到达的帧不丢失
+ * io_uring后端下读走multishot recv，数据随完成事件到达，poll只用来等EPOLLOUT；发送两种后端都直接sendmsg
+ * 超时用loop的定时器，以fd为id：请求开始后headerTimeoutMs内必须收齐，中途收到数据不顺延；
+ * 空闲时按idleTimeoutMs/webSocketIdleTimeoutMs计时
+ * 背压：发送队列积压到highWaterMark就不再读这个对端，慢客户端最多让连接积压高水位加一批响应/消息
+ * 连接关闭后对象在loop本轮结束时释放
+ */
+class HttpConn {
+public:
+	// fd为已accept的非阻塞socket，之后由连接负责关闭
+	static HttpConn* open(EventLoop& loop, int fd, const HttpConnOptions& options) {
+		HttpConn* conn = new HttpConn(loop, fd, options);
+		UringPoller* uring = loop.GetPoller().Uring();
+		if (uring && (uring->HasBufferRing() || uring->SetupBufferRing(http_conn::kRecvBuffers, http_conn::kRecvBufferSize))) {
+			conn->m_recvRing = true;
+			conn->m_events = 0;
+			conn->m_channel = loop.AddFd(fd, 0, [conn](uint32_t events) { conn->handleEvent(events); },
+				[conn](const UringCompletion& c) { conn->handleRecv(c); });
+		} else {
+			conn->m_channel = loop.AddFd(fd, EPOLLIN, [conn](uint32_t events) { conn->handleEvent(events); });
+		}
+		if (conn->m_channel == EventLoop::kInvalidChannel) {
+			::close(fd);
+			delete conn;
+			return nullptr;
+		}
+		if (conn->m_recvRing) {
+			conn->m_recvArmed = uring->PrepRecv(fd, conn->m_channel);
+		}
+		loop.GetTimer().add(fd, options.headerTimeoutMs, [conn] { conn->onTimeout(); });
+		return conn;
+	}
+
+	HttpConn(const HttpConn&) = delete;
+	HttpConn& operator=(const HttpConn&) = delete;
+
+	// 回复当前请求，body被拷贝一次和响应头放在一起；extraHeaders每行以CRLF结尾
+	void sendResponse(int status, std::string_view body, std::string_view contentType = "text/plain",
+			std::string_view extraHeaders = {}) {
+		std::string head = buildHead(status, body.size(), contentType, extraHeaders);
+		m_output.push(EncodedFrame::fromBytes(asBytes(head), asBytes(body)));
+	}
+
+	// 只发响应头，Content-Length为contentLength；用于HEAD、304和随后用sendFile发送的body
+	void sendHead(int status, std::size_t contentLength, std::string_view contentType = {},
+			std::string_view extraHeaders = {}) {
+		std::string head = buildHead(status, contentLength, contentType, extraHeaders);
+		m_output.push(EncodedFrame::fromBytes(asBytes(head)));
+	}
+
+	// 发送预先编码好的完整响应，只能用于keep-alive的HTTP/1.1请求(见canSendPrepared)
+	void sendPrepared(EncodedFrameRef response) {
+		m_output.push(std::move(response));
+	}
+
+	bool canSendPrepared() const { return m_keepAlive && !m_http10; }
+
+	// 在已排队的响应头之后用sendfile发送文件的[offset, offset + length)，写不完时等EPOLLOUT接着发；
+	// 发送期间不再处理后续的流水线请求。sendfile没有MSG_NOSIGNAL，进程要忽略SIGPIPE
+	void sendFile(std::shared_ptr<const SharedFile> file, off_t offset, std::size_t length) {
+		assert(!m_transfer);
+		if (length > 0) {
+			m_transfer = FileTransfer{std::move(file), offset, length};
+		}
+	}
+
+	// 发送一条WebSocket消息；协商了permessage-deflate时按需压缩，否则载荷不拷贝
+	bool sendMessage(WebSocketOpcode opcode, std::span<const std::uint8_t> payload) {
+		if (m_closed || !m_webSocket) {
+			return false;
+		}
+		bool ok;
+		if (m_deflate) {
+			ok = m_output.send(m_fd, m_deflate->buildFrame(opcode, payload));
+		} else {
+			ok = m_output.send(m_fd, opcode, payload);
+		}
+		return afterWrite(ok);
+	}
+
+	// 发送编码好的共享帧(广播)，一次写完时不增加引用计数
+	bool sendFrame(const EncodedFrameRef& frame) {
+		if (m_closed || !m_webSocket) {
+			return false;
+		}
+		return afterWrite(m_output.send(m_fd, frame));
+	}
+
+	// 只入队不发送，随后用flush一次写出；广播时同一批的多条消息合并成一次sendmsg
+	bool queueFrame(const EncodedFrameRef& frame) {
+		if (m_closed || !m_webSocket) {
+			return false;
+		}
+		m_output.push(frame);
+		return true;
+	}
+
+	bool flush() {
+		if (m_closed) {
+			return false;
+		}
+		return afterWrite(flushOutput());
+	}
+
+	// WebSocket连接发送Close帧后关闭，HTTP连接写完已排队的响应后关闭
+	void close(std::uint16_t code = 1000) {
+		if (m_closed) {
+			return;
+		}
+		if (m_webSocket) {
+			sendClose(code);
+		} else {
+			m_closeAfterWrite = true;
+		}
+		updateInterest();
+	}
+
+	// 不发Close帧、不等发送队列写完，立即断开；用于踢掉慢消费者
+	void abort() { closeNow(); }
+
+	int fd() const { return m_fd; }
+	EventLoop& loop() { return m_loop; }
+	bool closed() const { return m_closed; }
+	// 发送队列里还没写出的字节数
+	std::size_t pendingBytes() const { return m_output.pendingBytes(); }
+	// 因发送积压停止读
+	bool readPaused() const { return m_readPaused; }
+	bool isWebSocket() const { return m_webSocket; }
+	PerMessageDeflate* deflate() { return m_deflate ? &*m_deflate : nullptr; }
+
+private:
+	HttpConn(EventLoop& loop, int fd, const HttpConnOptions& options)
+		: m_loop{loop}, m_fd{fd}, m_options{options},
+		  m_parser{options.maxHeaderBytes, options.maxBody},
+		  m_assembler{options.maxMessage} {}
+
+	struct FileTransfer {
+		std::shared_ptr<const SharedFile> file;
+		off_t offset;
+		std::size_t remaining;
+	};
+
+	static std::span<const std::uint8_t> asBytes(std::string_view s) {
+		return {reinterpret_cast<const std::uint8_t*>(s.data()), s.size()};
+	}
+
+	std::string buildHead(int status, std::size_t contentLength, std::string_view contentType, std::string_view extraHeaders) {
+		std::string head;
+		head.reserve(128 + extraHeaders.size());
+		head += m_http10 ? "HTTP/1.0 " : "HTTP/1.1 ";
+		head += std::to_string(status);
+		head += ' ';
+		head += http_conn::reasonPhrase(status);
+		head += "\r\nContent-Length: ";
+		head += std::to_string(contentLength);
+		if (!contentType.empty()) {
+			head += "\r\nContent-Type: ";
+			head += contentType;
+		}
+		if (!m_keepAlive) {
+			head += "\r\nConnection: close";
+			m_closeAfterWrite = true;
+		} else if (m_http10) {
+			head += "\r\nConnection: keep-alive";
+		}
+		head += "\r\n";
+		head += extraHeaders;
+		head += "\r\n";
+		return head;
+	}
+
+	// 先写发送队列，队列写空后接着sendfile；返回false表示连接出错
+	bool flushOutput() {
+		if (!m_output.flush(m_fd)) {
+			return false;
+		}
+		if (!m_transfer || !m_output.empty()) {
+			return true;
+		}
+		bool progressed = false;
+		for (int round = 0; round < http_conn::kSendfileRounds && m_transfer->remaining > 0; ++round) {
+			ssize_t n = ::sendfile(m_fd, m_transfer->file->fd(), &m_transfer->offset,
+				std::min(m_transfer->remaining, http_conn::kSendfileChunk));
+			if (n < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				if (errno != EAGAIN) {
+					return false;
+				}
+				break;
+			}
+			if (n == 0) {
+				// 文件在发送过程中被截断，已经声明的Content-Length发不完，只能断开
+				return false;
+			}
+			m_transfer->remaining -= static_cast<std::size_t>(n);
+			progressed = true;
+		}
+		if (progressed) {
+			// 慢速客户端下载大文件时不算空闲
+			m_loop.GetTimer().adjust(m_fd, m_options.idleTimeoutMs);
+		}
+		if (m_transfer->remaining == 0) {
+			m_transfer.reset();
+		}
+		return true;
+	}
+
+	void handleEvent(uint32_t events) {
+		if ((events & (EPOLLHUP | EPOLLERR)) && !(events & EPOLLIN)) {
+			closeNow();
+			return;
+		}
+		if (events & EPOLLIN) {
+			handleRead();
+		}
+		if (!m_closed && (events & EPOLLOUT)) {
+			bool transferring = m_transfer.has_value();
+			bool backlog = !m_output.empty();
+			if (!flushOutput()) {
+				closeNow();
+				return;
+			}
+			if (backlog && m_output.empty() && m_options.onDrain) {
+				m_options.onDrain(*this);
+			}
+			checkWaterMarks();
+			// 文件发完后接着处理读缓冲区里排着的请求；积压回落时由checkWaterMarks安排
+			if (!m_closed && transferring && !m_transfer && !m_readPaused && !m_input.empty()) {
+				processInput();
+			}
+		}
+		if (!m_closed) {
+			updateInterest();
+		}
+	}
+
+	// 未处理的数据超过当前协议的最大请求/帧时解析器早该报错，这里只是兜底
+	bool inputOverLimit() const {
+		std::size_t limit = m_webSocket ? m_options.maxMessage + 14 : m_options.maxHeaderBytes + m_options.maxBody;
+		return m_input.size() >= limit;
+	}
+
+	bool wantRead() const {
+		return !m_closeAfterWrite && !m_transfer && !m_readPaused;
+	}
+
+	void handleRead() {
+		// 一次事件最多读几轮，避免一个连接占住loop
+		for (int round = 0; round < 16 && !m_closed && wantRead(); ++round) {
+			if (inputOverLimit()) {
+				closeNow();
+				return;
+			}
+			ssize_t n = m_input.readFd(m_fd);
+			if (n == 0) {
+				// 对端关闭写端：已排队的响应写完后关闭
+				m_closeAfterWrite = true;
+				return;
+			}
+			if (n < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				if (errno != EAGAIN && errno != EWOULDBLOCK) {
+					closeNow();
+				}
+				return;
+			}
+			processInput();
+			// 连溢出区都没填满，socket已经读空
+			if (static_cast<std::size_t>(n) < ChainBuffer::kSpillSize) {
+				return;
+			}
+		}
+	}
+
+	// io_uring后端的recv完成事件：数据拷进读缓冲区后和handleRead读到的一样处理
+	void handleRecv(const UringCompletion& c) {
+		if (!c.more) {
+			m_recvArmed = false;
+		}
+		if (m_closed) {
+			return;
+		}
+		if (c.result > 0) {
+			if (inputOverLimit()) {
+				closeNow();
+				return;
+			}
+			m_input.append(c.buffer);
+			// 取消停读之前已经收到的数据先留在读缓冲区里，恢复读时处理
+			if (wantRead()) {
+				processInput();
+			}
+		} else if (c.result == 0) {
+			m_closeAfterWrite = true;
+		} else if (c.result != -ENOBUFS && c.result != -ECANCELED) {
+			// ENOBUFS是buffer暂时用完，ECANCELED是停读时取消的，由updateInterest重新挂上
+			closeNow();
+			return;
+		}
+		if (!m_closed) {
+			updateInterest();
+		}
+	}
+
+	/*
+	 * 解析器要更多数据时调用：未处理的数据跨了几段时合并成一段，返回true表示应再解析一次
+	 * expected为已知的完整长度(帧载荷、Content-Length)，预留出来让后续数据直接读进同一段；
+	 * 不知道时按已有数据的两倍预留，避免反复合并
+	 */
+	bool pullupInput(std::size_t expected) {
+		bool split = m_input.linkCount() > 1;
+		if (split || expected > m_input.frontCapacity()) {
+			m_input.pullup(std::max(expected, split ? m_input.size() * 2 : 0));
+		}
+		return split;
+	}
+
+	void processInput() {
+		if (!m_webSocket) {
+			processRequests();
+		}
+		if (m_webSocket && !m_closed) {
+			processFrames();
+		}
+	}
+
+	void processRequests() {
+		// 请求只在回调期间使用，放在栈上，不占连接的内存
+		HttpRequest request;
+		bool completed = false;
+		while (!m_closed && !m_input.empty() && !m_closeAfterWrite && !m_webSocket && !m_transfer && !m_readPaused) {
+			std::span<std::uint8_t> front = m_input.front();
+			std::string_view data{reinterpret_cast<const char*>(front.data()), front.size()};
+			std::size_t consumed;
+			HttpParseStatus status = m_parser.parse(data, consumed, request);
+			if (status == HttpParseStatus::NeedMore) {
+				m_input.consume(consumed);
+				if (pullupInput(m_parser.expectedSize())) {
+					continue;
+				}
+				break;
+			}
+			if (status == HttpParseStatus::Error) {
+				sendError(m_parser.errorStatus());
+				break;
+			}
+			completed = true;
+			m_keepAlive = request.keepAlive;
+			m_http10 = request.versionMinor == 0;
+			if (m_options.onMessage && isWebSocketUpgrade(request)) {
+				upgrade(request);
+			} else if (m_options.onRequest) {
+				m_options.onRequest(*this, request);
+			} else {
+				sendResponse(404, {});
+			}
+			// 回调里可能abort/flush出错关闭了连接，fd已经关掉，不能再处理后面的请求或写出
+			if (m_closed) {
+				return;
+			}
+			// 请求指向读缓冲区，回调返回后才能去掉
+			m_input.consume(consumed);
+			// 文件如果一次就发完了，接着处理后面的请求，否则等EPOLLOUT；
+			// 流水线上的响应攒到高水位时先写一次，写不出去才停下
+			if ((m_transfer || aboveHighWater()) && !flushOutput()) {
+				closeNow();
+				return;
+			}
+			checkWaterMarks();
+		}
+		if (m_webSocket || m_closed) {
+			return;
+		}
+
+		// 没有未完成的请求时按空闲计时；新请求开始时才设置头部超时，之后收到数据不顺延
+		auto& timer = m_loop.GetTimer();
+		if (m_input.empty()) {
+			timer.adjust(m_fd, m_options.idleTimeoutMs);
+			m_requestTimer = false;
+		} else if (completed || !m_requestTimer) {
+			timer.adjust(m_fd, m_options.headerTimeoutMs);
+			m_requestTimer = true;
+		}
+		if (!flushOutput()) {
+			closeNow();
+		}
+	}
+
+	void upgrade(const HttpRequest& request) {
+		if (m_options.onUpgrade && !m_options.onUpgrade(*this, request)) {
+			sendError(403);
+			return;
+		}
+		if (m_closed) {
+			return;
+		}
+		std::string response;
+		std::optional<PerMessageDeflateConfig> agreed;
+		int status = acceptWebSocketUpgrade(request, response, m_options.deflatePolicy, agreed);
+		if (status != 101) {
+			sendError(status);
+			return;
+		}
+		m_output.push(EncodedFrame::fromBytes(asBytes(response)));
+		if (agreed) {
+			m_deflate.emplace(*agreed);
+			m_assembler.setDeflate(&*m_deflate);
+		}
+		m_webSocket = true;
+		m_loop.GetTimer().adjust(m_fd, m_options.webSocketIdleTimeoutMs);
+		if (!flushOutput()) {
+			closeNow();
+			return;
+		}
+		if (m_options.onOpen) {
+			m_options.onOpen(*this);
+		}
+	}
+
+	void processFrames() {
+		m_loop.GetTimer().adjust(m_fd, m_options.webSocketIdleTimeoutMs);
+		while (!m_closed && !m_closeAfterWrite && !m_readPaused && !m_input.empty()) {
+			std::size_t consumed;
+			WebSocketMessage msg;
+			WebSocketMessageStatus status = m_assembler.parse(m_input.front(), consumed, msg);
+			if (status == WebSocketMessageStatus::NeedMore) {
+				m_input.consume(consumed);
+				if (pullupInput(m_assembler.pendingPayload())) {
+					continue;
+				}
+				break;
+			}
+			if (status == WebSocketMessageStatus::Error) {
+				sendClose(m_assembler.closeCode());
+				break;
+			}
+			if (status == WebSocketMessageStatus::Control) {
+				handleControl(msg);
+			} else if (m_options.onMessage) {
+				m_options.onMessage(*this, msg);
+			}
+			// 未分片的消息指向读缓冲区，回调返回后才能去掉
+			m_input.consume(consumed);
+		}
+		m_assembler.trim();
+		if (!m_closed && !flushOutput()) {
+			closeNow();
+		}
+	}
+
+	void handleControl(const WebSocketMessage& msg) {
+		switch (msg.opcode) {
+		case WebSocketOpcode::Ping:
+			m_output.push(EncodedFrame::make(WebSocketOpcode::Pong, msg.payload));
+			break;
+		case WebSocketOpcode::Close:
+			// 回复同样的状态码后关闭
+			if (msg.payload.size() >= 2) {
+				sendClose(static_cast<std::uint16_t>(msg.payload[0] << 8 | msg.payload[1]));
+			} else {
+				m_output.push(EncodedFrame::make(WebSocketOpcode::Close, {}));
+				m_closeAfterWrite = true;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	void sendClose(std::uint16_t code) {
+		std::uint8_t payload[2] = {static_cast<std::uint8_t>(code >> 8), static_cast<std::uint8_t>(code)};
+		m_output.push(EncodedFrame::make(WebSocketOpcode::Close, payload));
+		m_closeAfterWrite = true;
+	}
+
+	void sendError(int status) {
+		m_keepAlive = false;
+		sendResponse(status, {}, {}, status == 426 ? "Sec-WebSocket-Version: 13\r\n" : std::string_view{});
+	}
+
+	void onTimeout() {
+		if (m_closed) {
+			return;
+		}
+		// 定时器已经移除，关闭前要重新挂上，否则写不完时没有兜底
+		m_loop.GetTimer().add(m_fd, m_options.headerTimeoutMs, [this] { closeNow(); });
+		if (m_webSocket) {
+			sendClose(1001);
+		} else if (!m_input.empty()) {
+			sendError(408);
+		} else {
+			m_closeAfterWrite = true;
+		}
+		if (!flushOutput()) {
+			closeNow();
+			return;
+		}
+		updateInterest();
+	}
+
+	bool afterWrite(bool ok) {
+		if (!ok) {
+			closeNow();
+			return false;
+		}
+		updateInterest();
+		return true;
+	}
+
+	bool aboveHighWater() const {
+		return m_options.highWaterMark > 0 && m_output.pendingBytes() >= m_options.highWaterMark;
+	}
+
+	/*
+	 * 积压越过高水位时停止读，回落到低水位以下时恢复；EPOLLIN由updateInterest按m_readPaused设置
+	 * 积压可能在任何写出的地方回落(EPOLLOUT、flush、sendMessage)，停读期间已读到的请求/消息
+	 * 在本轮事件处理完后接着处理，不能等对端再发数据
+	 */
+	void checkWaterMarks() {
+		if (m_closed) {
+			return;
+		}
+		HttpConnMetrics* metrics = m_options.metrics;
+		if (!m_readPaused && aboveHighWater()) {
+			m_readPaused = true;
+			if (metrics) {
+				metrics->highWaterEvents.fetch_add(1, std::memory_order_relaxed);
+				metrics->readPaused.fetch_add(1, std::memory_order_relaxed);
+			}
+			if (m_options.onHighWater) {
+				m_options.onHighWater(*this, m_output.pendingBytes());
+			}
+		} else if (m_readPaused && m_output.pendingBytes() <= m_options.lowWaterMark) {
+			m_readPaused = false;
+			if (metrics) {
+				metrics->lowWaterEvents.fetch_add(1, std::memory_order_relaxed);
+				metrics->readPaused.fetch_sub(1, std::memory_order_relaxed);
+			}
+			if (m_options.onLowWater) {
+				m_options.onLowWater(*this, m_output.pendingBytes());
+			}
+			if (!m_closed && !m_input.empty() && !m_resumeQueued) {
+				// 可能正在发送方的调用栈里(如广播时的flush)，推迟处理；连接关闭后的释放排在它之后
+				m_resumeQueued = true;
+				m_loop.QueueInLoop([this] { resumeInput(); });
+			}
+		}
+	}
+
+	void resumeInput() {
+		m_resumeQueued = false;
+		if (m_closed || m_readPaused || m_input.empty()) {
+			return;
+		}
+		processInput();
+		if (!m_closed) {
+			updateInterest();
+		}
+	}
+
+	// 写完后要关闭的连接、发文件中和积压过多的连接不再读；有数据没写完时监听EPOLLOUT
+	// io_uring后端下读由recv请求负责：要读时挂上，不读时取消，poll只剩EPOLLOUT
+	void updateInterest() {
+		checkWaterMarks();
+		if (m_closed) {
+			return;
+		}
+		if (m_closeAfterWrite && m_output.empty() && !m_transfer) {
+			closeNow();
+			return;
+		}
+		bool writing = !m_output.empty() || m_transfer;
+		bool reading = wantRead();
+		if (m_recvRing) {
+			UringPoller* uring = m_loop.GetPoller().Uring();
+			if (reading && !m_recvArmed) {
+				m_recvArmed = uring->PrepRecv(m_fd, m_channel);
+				m_recvCancelled = false;
+			} else if (!reading && m_recvArmed && !m_recvCancelled) {
+				m_recvCancelled = uring->CancelRecv(m_fd);
+			}
+			reading = false;
+		}
+		uint32_t events = (reading ? static_cast<uint32_t>(EPOLLIN) : 0u) | (writing ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+		if (events != m_events) {
+			m_events = events;
+			m_loop.ModFd(m_channel, events);
+		}
+	}
+
+	void closeNow() {
+		if (m_closed) {
+			return;
+		}
+		m_closed = true;
+		if (m_readPaused && m_options.metrics) {
+			m_options.metrics->readPaused.fetch_sub(1, std::memory_order_relaxed);
+		}
+		// 回调里看到m_closed直接返回，这里只是把定时器移除
+		m_loop.GetTimer().doWork(m_fd);
+		m_loop.DelFd(m_channel);
+		::close(m_fd);
+		if (m_options.onClose) {
+			m_options.onClose(*this);
+		}
+		HttpConn* self = this;
+		m_loop.QueueInLoop([self] { delete self; });
+	}
+
+	EventLoop& m_loop;
+	int m_fd;
+	const HttpConnOptions& m_options;
+	EventLoop::ChannelHandle m_channel = EventLoop::kInvalidChannel;
+	uint32_t m_events = EPOLLIN;
+
+	HttpRequestParser m_parser;
+	WebSocketMessageAssembler m_assembler;
+	std::optional<PerMessageDeflate> m_deflate;
+
+	ChainBuffer m_input;					// HTTP和WebSocket共用的读缓冲区，只含未处理的数据
+	WebSocketSendQueue m_output;
+	std::optional<FileTransfer> m_transfer;
+
+	bool m_webSocket = false;
+	bool m_keepAlive = true;
+	bool m_http10 = false;
+	bool m_requestTimer = true;			// 正在按headerTimeoutMs计时(连接建立时就开始)
+	bool m_closeAfterWrite = false;
+	bool m_readPaused = false;			// 发送积压越过高水位，等回落到低水位
+	bool m_resumeQueued = false;		// 回落到低水位后已安排resumeInput
+	bool m_recvRing = false;			// io_uring后端，读走multishot recv
+	bool m_recvArmed = false;			// recv请求还没结束(收到more为false的完成事件前)
+	bool m_recvCancelled = false;		// 停读时已提交取消，等它结束
+	bool m_closed = false;
+};
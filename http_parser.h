@@ -0,0 +1,340 @@
+#pragma once
+
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+enum class HttpParseStatus : std::uint8_t {
+	Ok,				// 解析出一个完整请求(含body)
+	NeedMore,		// 数据不够，读到更多数据后从data + consumed接着调用
+	Error			// 应回复errorStatus()并关闭连接
+};
+
+struct HttpHeader {
+	std::string_view name;
+	std::string_view value;
+};
+
+// 解析出的请求，所有string_view都指向调用方的读缓冲区，缓冲区被改写或移动前有效
+struct HttpRequest {
+	static constexpr std::size_t kMaxHeaders = 64;
+
+	std::string_view method;
+	std::string_view target;
+	std::string_view path;
+	std::string_view query;
+	int versionMinor = 1;
+	HttpHeader headers[kMaxHeaders];
+	std::size_t headerCount = 0;
+	std::string_view body;
+	bool keepAlive = true;
+	bool upgrade = false;			// Connection里带upgrade且有Upgrade头
+
+	// 头部名不区分大小写，没有时返回空
+	std::string_view header(std::string_view name) const;
+};
+
+namespace http_parse {
+
+inline constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+inline char lower(char c) {
+	return c >= 'A' && c <= 'Z' ? static_cast<char>(c + 32) : c;
+}
+
+inline bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+	if (a.size() != b.size()) {
+		return false;
+	}
+	for (std::size_t i = 0; i < a.size(); ++i) {
+		if (lower(a[i]) != lower(b[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// 逗号分隔的列表(如Connection)里是否有token，不区分大小写
+inline bool hasToken(std::string_view list, std::string_view token) {
+	while (!list.empty()) {
+		std::size_t comma = list.find(',');
+		std::string_view item = list.substr(0, comma);
+		while (!item.empty() && (item.front() == ' ' || item.front() == '\t')) item.remove_prefix(1);
+		while (!item.empty() && (item.back() == ' ' || item.back() == '\t')) item.remove_suffix(1);
+		if (equalsIgnoreCase(item, token)) {
+			return true;
+		}
+		if (comma == std::string_view::npos) {
+			break;
+		}
+		list.remove_prefix(comma + 1);
+	}
+	return false;
+}
+
+// RFC 9110 tchar
+inline bool isTokenChar(unsigned char c) {
+	static constexpr auto table = [] {
+		struct { bool v[256]{}; } t;
+		for (int c = '0'; c <= '9'; ++c) t.v[c] = true;
+		for (int c = 'a'; c <= 'z'; ++c) t.v[c] = true;
+		for (int c = 'A'; c <= 'Z'; ++c) t.v[c] = true;
+		for (char c : std::string_view{"!#$%&'*+-.^_`|~"}) t.v[static_cast<unsigned char>(c)] = true;
+		return t;
+	}();
+	return table.v[c];
+}
+
+// p[i]为'\n'，判断它是否结束了一个空行(CRLF CRLF或LF LF)
+inline bool endsBlankLine(const char* p, std::size_t i) {
+	return (i >= 1 && p[i - 1] == '\n') || (i >= 2 && p[i - 1] == '\r' && p[i - 2] == '\n');
+}
+
+/*
+ * 从from开始找头部结尾的空行，返回空行之后的位置，没找到返回npos
+ * SSE2一次比较16字节找'\n'，只在换行处检查前面的字节；from之前已扫描过的部分不再重复扫描
+ */
+inline std::size_t findHeaderEnd(const char* p, std::size_t size, std::size_t from) {
+	std::size_t i = from;
+#if defined(__SSE2__)
+	const __m128i lf = _mm_set1_epi8('\n');
+	for (; i + 16 <= size; i += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+		unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, lf)));
+		while (mask != 0) {
+			std::size_t j = i + static_cast<std::size_t>(std::countr_zero(mask));
+			if (endsBlankLine(p, j)) {
+				return j + 1;
+			}
+			mask &= mask - 1;
+		}
+	}
+#endif
+	for (; i < size; ++i) {
+		if (p[i] == '\n' && endsBlankLine(p, i)) {
+			return i + 1;
+		}
+	}
+	return npos;
+}
+
+// 取出一行(不含行尾的CRLF或LF)，line之后剩下的部分留在data里
+inline std::string_view nextLine(std::string_view& data) {
+	std::size_t lf = data.find('\n');
+	std::string_view line = data.substr(0, lf);
+	data.remove_prefix(lf == std::string_view::npos ? data.size() : lf + 1);
+	if (!line.empty() && line.back() == '\r') {
+		line.remove_suffix(1);
+	}
+	return line;
+}
+
+} // namespace http_parse
+
+inline std::string_view HttpRequest::header(std::string_view name) const {
+	for (std::size_t i = 0; i < headerCount; ++i) {
+		if (http_parse::equalsIgnoreCase(headers[i].name, name)) {
+			return headers[i].value;
+		}
+	}
+	return {};
+}
+
+/*
+ * 增量HTTP/1.1请求解析器，不拷贝、不分配内存
+ * 每次从读缓冲区里未处理数据的开头调用；Ok时consumed为整个请求(含body)的长度，
+ * 流水线上的下一个请求从data + consumed接着解析
+ * NeedMore时只会消耗请求前多余的空行，已扫描过的位置记在解析器里
+ * 不支持Transfer-Encoding(chunked)，这类请求以501拒绝
+ */
+class HttpRequestParser {
+public:
+	explicit HttpRequestParser(std::size_t maxHeaderBytes = 8 * 1024, std::size_t maxBody = 1024 * 1024)
+		: m_maxHeaderBytes{maxHeaderBytes}, m_maxBody{maxBody} {}
+
+	HttpParseStatus parse(std::string_view data, std::size_t& consumed, HttpRequest& req) {
+		consumed = 0;
+		if (m_errorStatus != 0) {
+			return HttpParseStatus::Error;
+		}
+		if (m_headerEnd == http_parse::npos) {
+			// 请求之间允许有多余的空行
+			std::size_t skip = 0;
+			while (skip < data.size() && (data[skip] == '\r' || data[skip] == '\n')) {
+				++skip;
+			}
+			if (skip > 0 && skip == data.size()) {
+				consumed = skip;
+				return HttpParseStatus::NeedMore;
+			}
+			std::size_t end = http_parse::findHeaderEnd(data.data() + skip, data.size() - skip, m_scanned);
+			if (end == http_parse::npos) {
+				if (data.size() - skip > m_maxHeaderBytes) {
+					return fail(431);
+				}
+				// 只在'\n'处向前看，新数据里的换行能看到已扫描部分的结尾，不需要回退
+				m_scanned = data.size() - skip;
+				consumed = skip;
+				m_skipped = 0;
+				return HttpParseStatus::NeedMore;
+			}
+			if (end > m_maxHeaderBytes) {
+				return fail(431);
+			}
+			m_skipped = skip;
+			m_headerEnd = skip + end;
+		}
+		// 等body时头部已经校验过，body到齐后再解析一次填写req(缓冲区可能已经移动)
+		if (m_headerParsed && data.size() - m_headerEnd < m_bodyLength) {
+			return HttpParseStatus::NeedMore;
+		}
+		if (int status = parseHead(data.substr(m_skipped, m_headerEnd - m_skipped), req)) {
+			return fail(status);
+		}
+		m_headerParsed = true;
+		if (data.size() - m_headerEnd < m_bodyLength) {
+			return HttpParseStatus::NeedMore;
+		}
+		req.body = data.substr(m_headerEnd, m_bodyLength);
+		consumed = m_headerEnd + m_bodyLength;
+		reset();
+		return HttpParseStatus::Ok;
+	}
+
+	void reset() {
+		m_scanned = 0;
+		m_skipped = 0;
+		m_headerEnd = http_parse::npos;
+		m_bodyLength = 0;
+		m_headerParsed = false;
+		m_errorStatus = 0;
+	}
+
+	// 出错时应回复的状态码：400、413、431、501或505
+	int errorStatus() const { return m_errorStatus; }
+
+	// 头部已解析、等待body时返回整个请求的长度(从传给parse的data开头算)，否则返回0
+	std::size_t expectedSize() const {
+		return m_headerParsed ? m_headerEnd + m_bodyLength : 0;
+	}
+
+private:
+	HttpParseStatus fail(int status) {
+		m_errorStatus = status;
+		return HttpParseStatus::Error;
+	}
+
+	// 解析请求行和头部，成功返回0，否则返回应回复的状态码
+	int parseHead(std::string_view head, HttpRequest& req) {
+		using namespace http_parse;
+		std::string_view line = nextLine(head);
+
+		// 请求行：method SP request-target SP HTTP-version
+		std::size_t sp1 = line.find(' ');
+		std::size_t sp2 = sp1 == std::string_view::npos ? sp1 : line.find(' ', sp1 + 1);
+		if (sp2 == std::string_view::npos || sp1 == 0 || sp2 == sp1 + 1) {
+			return 400;
+		}
+		req.method = line.substr(0, sp1);
+		req.target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+		std::string_view version = line.substr(sp2 + 1);
+		for (char c : req.method) {
+			if (!isTokenChar(static_cast<unsigned char>(c))) {
+				return 400;
+			}
+		}
+		for (char c : req.target) {
+			if (static_cast<unsigned char>(c) <= ' ' || c == 0x7F) {
+				return 400;
+			}
+		}
+		if (version.size() != 8 || version.substr(0, 5) != "HTTP/" || version[6] != '.' ||
+				version[5] < '0' || version[5] > '9' || version[7] < '0' || version[7] > '9') {
+			return 400;
+		}
+		if (version[5] != '1') {
+			return 505;
+		}
+		req.versionMinor = version[7] - '0';
+		std::size_t question = req.target.find('?');
+		req.path = req.target.substr(0, question);
+		req.query = question == std::string_view::npos ? std::string_view{} : req.target.substr(question + 1);
+
+		req.headerCount = 0;
+		std::string_view connection;
+		bool hasHost = false;
+		bool hasLength = false;
+		bool hasUpgrade = false;
+		m_bodyLength = 0;
+		while (!head.empty()) {
+			line = nextLine(head);
+			if (line.empty()) {
+				break;
+			}
+			// 不支持旧式的折行
+			if (line.front() == ' ' || line.front() == '\t') {
+				return 400;
+			}
+			std::size_t colon = line.find(':');
+			if (colon == std::string_view::npos || colon == 0) {
+				return 400;
+			}
+			std::string_view name = line.substr(0, colon);
+			for (char c : name) {
+				if (!isTokenChar(static_cast<unsigned char>(c))) {
+					return 400;
+				}
+			}
+			std::string_view value = line.substr(colon + 1);
+			while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+			while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+			if (req.headerCount == HttpRequest::kMaxHeaders) {
+				return 431;
+			}
+			req.headers[req.headerCount++] = {name, value};
+
+			if (equalsIgnoreCase(name, "content-length")) {
+				std::uint64_t length;
+				auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), length);
+				if (ec != std::errc{} || ptr != value.data() + value.size() || (hasLength && length != m_bodyLength)) {
+					return 400;
+				}
+				if (length > m_maxBody) {
+					return 413;
+				}
+				hasLength = true;
+				m_bodyLength = static_cast<std::size_t>(length);
+			} else if (equalsIgnoreCase(name, "transfer-encoding")) {
+				return 501;
+			} else if (equalsIgnoreCase(name, "connection")) {
+				connection = value;
+			} else if (equalsIgnoreCase(name, "host")) {
+				hasHost = true;
+			} else if (equalsIgnoreCase(name, "upgrade")) {
+				hasUpgrade = true;
+			}
+		}
+		if (req.versionMinor >= 1 && !hasHost) {
+			return 400;
+		}
+		req.keepAlive = req.versionMinor >= 1 ? !hasToken(connection, "close") : hasToken(connection, "keep-alive");
+		req.upgrade = hasUpgrade && hasToken(connection, "upgrade");
+		req.body = {};
+		return 0;
+	}
+
+	std::size_t m_maxHeaderBytes;
+	std::size_t m_maxBody;
+	std::size_t m_scanned = 0;					// 已扫描过的头部字节(相对跳过空行之后)
+	std::size_t m_skipped = 0;					// 请求前跳过的空行字节
+	std::size_t m_headerEnd = http_parse::npos;	// 头部结束位置，已找到时等待body
+	std::size_t m_bodyLength = 0;
+	bool m_headerParsed = false;
+	int m_errorStatus = 0;
+};
@@ -0,0 +1,102 @@
+/*
+ * 只可移动的void()任务类型，替代std::function
+ * 可调用对象不超过Capacity且可无异常移动时直接存放在内部缓冲区，不分配内存；
+ * 超出时退化为堆分配，可用fits_inline<F>在编译期检查
+ */
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template <std::size_t Capacity = 64>
+class inplace_task
+{
+public:
+    template <typename F>
+    static constexpr bool fits_inline = sizeof(F) <= Capacity
+        && alignof(F) <= alignof(std::max_align_t)
+        && std::is_nothrow_move_constructible_v<F>;
+
+    inplace_task() noexcept = default;
+
+    template <typename F, typename D = std::decay_t<F>>
+    requires (!std::is_same_v<D, inplace_task> && std::is_invocable_r_v<void, D&>)
+    inplace_task(F&& f)
+    {
+        if constexpr (fits_inline<D>) {
+            ::new (static_cast<void*>(m_buf)) D(std::forward<F>(f));
+            m_ops = &inline_ops<D>;
+        } else {
+            ::new (static_cast<void*>(m_buf)) D*(new D(std::forward<F>(f)));
+            m_ops = &heap_ops<D>;
+        }
+    }
+
+    inplace_task(inplace_task&& other) noexcept
+    {
+        if (other.m_ops) {
+            other.m_ops->move(m_buf, other.m_buf);
+            m_ops = std::exchange(other.m_ops, nullptr);
+        }
+    }
+
+    inplace_task& operator=(inplace_task&& other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            if (other.m_ops) {
+                other.m_ops->move(m_buf, other.m_buf);
+                m_ops = std::exchange(other.m_ops, nullptr);
+            }
+        }
+        return *this;
+    }
+
+    inplace_task(const inplace_task&) = delete;
+    inplace_task& operator=(const inplace_task&) = delete;
+
+    ~inplace_task() { reset(); }
+
+    void operator()() { m_ops->invoke(m_buf); }
+
+    explicit operator bool() const noexcept { return m_ops != nullptr; }
+
+    void reset() noexcept
+    {
+        if (m_ops) {
+            m_ops->destroy(m_buf);
+            m_ops = nullptr;
+        }
+    }
+
+private:
+    struct ops {
+        void (*invoke)(void*);
+        void (*move)(void* dst, void* src) noexcept;   // 移动后析构src
+        void (*destroy)(void*) noexcept;
+    };
+
+    template <typename D>
+    static constexpr ops inline_ops{
+        [](void* p) { std::invoke(*std::launder(static_cast<D*>(p))); },
+        [](void* dst, void* src) noexcept {
+            D* s = std::launder(static_cast<D*>(src));
+            ::new (dst) D(std::move(*s));
+            s->~D();
+        },
+        [](void* p) noexcept { std::launder(static_cast<D*>(p))->~D(); },
+    };
+
+    template <typename D>
+    static constexpr ops heap_ops{
+        [](void* p) { std::invoke(**static_cast<D**>(p)); },
+        [](void* dst, void* src) noexcept { ::new (dst) D*(*static_cast<D**>(src)); },
+        [](void* p) noexcept { delete *static_cast<D**>(p); },
+    };
+
+    alignas(std::max_align_t) unsigned char m_buf[Capacity < sizeof(void*) ? sizeof(void*) : Capacity];
+    const ops* m_ops = nullptr;
+};
@@ -1,19 +1,75 @@
 #include <stdio.h>
-#include <iostream>
 #include <string>
 #include <chrono>
 #include <thread>
 #include <mutex>
-#include <condition_variable>
-#include <queue>
 #include <filesystem>
+#include <iomanip>
 #include <format>
+#include <algorithm>
+#include <utility>
 #include <atomic>
+#include <memory>
+#include <sstream>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "spsc_queue.h"
+#include "mpmc_queue.h"
+#include "log_binary.h"
+#include "log_file.h"
 
 
 using namespace std::literals;
 
+// 日志落盘的时机，由调用方按需要在吞吐和可靠性之间取舍
+enum class log_durability
+{
+    relaxed,    // 缓冲区写满或每隔flush间隔写一次，吞吐最高，进程崩溃时可能丢最后一个间隔
+    line,       // 每行都唤醒写线程尽快写入文件映射，调用方不等待
+    sync,       // 同line，写线程每批写入之后再msync
+};
+
+// text为可直接阅读的文本；binary只记录格式串id和参数原始字节，用log_decoder还原
+enum class log_format
+{
+    text,
+    binary,
+};
+
+// 定长日志缓冲区，只有所属线程追加；commit之后写线程才能看到[0, committed)的内容
+class log_buffer
+{
+public:
+    explicit log_buffer(std::size_t capacity) : m_data{new char[capacity]}, m_capacity{capacity} {}
+
+    char* data() noexcept { return m_data.get(); }
+    char* cur() noexcept { return m_data.get() + m_size; }
+    std::size_t size() const noexcept { return m_size; }
+    std::size_t avail() const noexcept { return m_capacity - m_size; }
+    void add(std::size_t n) noexcept { m_size += n; }
+
+    void commit() noexcept { m_committed.store(m_size, std::memory_order_release); }
+    std::size_t committed() const noexcept { return m_committed.load(std::memory_order_acquire); }
+
+    void reset() noexcept
+    {
+        m_size = 0;
+        m_committed.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::unique_ptr<char[]> m_data;
+    std::size_t m_capacity;
+    std::size_t m_size = 0;
+    std::atomic<std::size_t> m_committed{0};
+};
+
 class Log final
 {
 public:
@@ -26,79 +82,193 @@ public:
     {
         Log::get_instance()->async_write_log();
     }
-    //可选择的参数有日志文件名称、是否关闭缓冲区、日志缓冲区大小、最大行数以及阻塞队列最大长度
-    bool init(const std::string_view file_name, bool close_log, int log_buf_size = 8192, int split_lines = 5000000, int max_queue_size = 0);
+    //可选择的参数有日志文件名称、是否关闭日志、每个线程的日志缓冲区大小、每个文件的最大行数、预分配的缓冲区数量(>=1时为异步模式)以及文件格式
+    bool init(const std::string_view file_name, bool close_log, int log_buf_size = 64 * 1024, int split_lines = 5000000, int max_queue_size = 0,
+              log_format format = log_format::text);
 
     template<typename... Args>
     void write_log(int level, const std::string_view fmt, Args&&... args);
 
+    // 二进制模式：由LOG_*宏调用，site为调用处的静态对象
+    template<typename... Args>
+    void write_binary(log_binary::site& site, const Args&... args);
+
+    // 让已写入缓冲区的日志尽快交给内核，不等待
     void flush();
 
+    void set_durability(log_durability d) noexcept { m_durability.store(d, std::memory_order_relaxed); }
+    // 日志文件按段预分配，写满一段也会切分，之后打开的段生效
+    void set_segment_size(std::size_t bytes) { m_file.set_segment_size(bytes); }
+    // 异步模式下写线程定时写出未满缓冲区的间隔
+    void set_flush_interval(std::chrono::milliseconds interval) noexcept { m_flush_interval_ms.store(static_cast<int>(interval.count()), std::memory_order_relaxed); }
+    bool is_closed() const noexcept { return m_levels.load(std::memory_order_relaxed) & kClosedBit; }
+    // 运行时按级别开关，不加锁；编译期被LOG_MIN_LEVEL去掉的级别不受影响
+    bool is_enabled(int level) const noexcept
+    {
+        return (m_levels.load(std::memory_order_relaxed) & (kClosedBit | 1u << level)) == 1u << level;
+    }
+    void set_level_enabled(int level, bool enabled) noexcept
+    {
+        if (enabled) m_levels.fetch_or(1u << level, std::memory_order_relaxed);
+        else m_levels.fetch_and(~(1u << level), std::memory_order_relaxed);
+    }
+    // 只保留level及以上的级别
+    void set_level(int level) noexcept
+    {
+        unsigned mask = kAllLevels & ~((1u << level) - 1);
+        unsigned cur = m_levels.load(std::memory_order_relaxed);
+        while (!m_levels.compare_exchange_weak(cur, (cur & kClosedBit) | mask, std::memory_order_relaxed)) {}
+    }
+    bool is_binary() const noexcept { return m_binary; }
+
 private:
     Log() = default;
     ~Log();
 
     void async_write_log();
+    // 按天/行数/段大小切分后写入一批数据；同步模式在m_mutex下调用，异步模式只在写线程中调用
+    void write_iov_(iovec* iov, int count);
+
+    // append(buf)把一条日志追加到buf，放不下时返回false；异步模式写本线程缓冲区，同步模式直接写文件
+    template<typename F>
+    void append_(F&& append);
+    template<typename... Args>
+    bool append_line_(log_buffer& buf, int level, std::string_view fmt, Args&... args);
+    static std::size_t format_prefix_(char* out, int level);
+
+    template<typename... Args>
+    void write_record_(log_binary::site& site, const Args&... args);
+    template<typename... Args>
+    void register_site_(log_binary::site& site);
+    template<typename... Args>
+    static bool append_record_(log_buffer& buf, const log_binary::site& site, const Args&... args);
+    // 新文件开头的文件头和全部格式记录、以及上次之后新登记的格式记录，只在写文件时调用
+    void write_preamble_();
+    void write_new_sites_();
+
+    log_buffer* acquire_buffer_();
+    void release_buffer_(log_buffer* buf);
+    void notify_writer_() noexcept;
+    void wait_writer_(int timeout_ms) noexcept;
+
+    // 每个写日志的线程一个当前缓冲区，写满后经SPSC队列交给写线程，再从缓冲池换一个新的
+    using full_ring = spsc_queue<log_buffer*, 64, futex_wait>;
+    struct producer {
+        full_ring full;
+        std::atomic<log_buffer*> active{nullptr};
+        std::atomic<bool> switching{false};
+        std::atomic<bool> exited{false};
+        // 以下只由写线程访问：正在读的缓冲区及已写出的位置
+        log_buffer* reading = nullptr;
+        std::size_t consumed = 0;
+
+        ~producer() { delete active.load(std::memory_order_relaxed); }
+    };
+    struct producer_handle {
+        std::shared_ptr<producer> p;
+        ~producer_handle() { if (p) p->exited.store(true, std::memory_order_release); }
+    };
+    producer& local_producer_();
+    log_buffer* swap_buffer_(producer& p);
+
+    // 一行日志(含前缀)至少要留出的空间，不足时换缓冲区
+    static constexpr std::size_t kMinLineSpace = 64;
+    static constexpr std::size_t kTimeTextSize = sizeof("YYYY-mm-dd HH:MM:SS");
+    static constexpr std::size_t kPoolCapacity = 256;
+    static constexpr int kMaxIov = 64;
 
 private:
-    std::string m_dir_name;
-    std::string m_log_name;
     int m_split_lines;
-    int m_log_buf_size;
-    long long m_count;
-    time_t m_today;
-    FILE* m_fp = nullptr;
-    char* m_buf = nullptr;
-    std::unique_ptr<block_queue<std::string>> m_log_queue;   //阻塞队列
+    std::size_t m_buf_size = 64 * 1024;
+    long long m_count;                          // 当前文件的行数
+    log_file m_file;
     std::unique_ptr<std::thread> m_write_thread;
+    std::unique_ptr<mpmc_queue<log_buffer*, kPoolCapacity>> m_pool;
+    std::mutex m_producers_mutex;
+    std::vector<std::shared_ptr<producer>> m_producers;
+    std::atomic<uint32_t> m_producers_version{0};
+    alignas(64) std::atomic<uint32_t> m_doorbell{0};            // 写线程在此休眠
+    std::atomic<uint32_t> m_doorbell_sleepers{0};
+    std::atomic<bool> m_stop{false};
+    static inline thread_local producer_handle t_producer;
     std::mutex m_mutex;
-    std::condition_variable m_cv;
     std::atomic<bool> m_is_async{false};
-    std::atomic<bool> m_close_log{false};
+    static constexpr unsigned kAllLevels = 0xF;
+    static constexpr unsigned kClosedBit = 1u << 7;
+    std::atomic<unsigned> m_levels{kAllLevels};   // 低4位为各级别开关，kClosedBit为关闭日志
+    std::atomic<log_durability> m_durability{log_durability::relaxed};
+    std::atomic<int> m_flush_interval_ms{1000};
+    bool m_binary = false;
+    std::mutex m_sites_mutex;
+    std::vector<std::string> m_sites;           // 已登记的格式记录(已编码)
+    std::size_t m_sites_written = 0;            // 当前文件中已写入的格式记录数
+    std::vector<iovec> m_sites_iov;
 };
 
-#define LOG_DEBUG(...) if (!m_close_log.load()) { Log::get_instance().write_log(0, __VA_ARGS__); Log::get_instance().flush(); }
-#define LOG_INFO(...) if (!m_close_log.load()) { Log::get_instance().write_log(1, __VA_ARGS__); Log::get_instance().flush(); }
-#define LOG_WARN(...) if (!m_close_log.load()) { Log::get_instance().write_log(2, __VA_ARGS__); Log::get_instance().flush(); }
-#define LOG_ERROR(...) if (!m_close_log.load()) { Log::get_instance().write_log(3, __VA_ARGS__); Log::get_instance().flush(); }
-
-bool Log::init(const std::string_view file_name, bool close_log, int log_buf_size, int split_lines, int max_queue_size)
+// fmt须为字符串字面量，二进制模式下用它和文件名、行号在编译期算出调用处id
+#define LOG_AT_(level, fmt, ...)                                                                         \
+    do {                                                                                                 \
+        Log* log_ = Log::get_instance();                                                                 \
+        if (!log_->is_enabled(level)) break;                                                             \
+        if (log_->is_binary()) {                                                                         \
+            static constexpr std::uint32_t log_site_id_ = log_binary::site_id(__FILE__, __LINE__, fmt); \
+            static log_binary::site log_site_{log_site_id_, level, fmt};                                 \
+            log_->write_binary(log_site_ __VA_OPT__(,) __VA_ARGS__);                                     \
+        } else {                                                                                         \
+            log_->write_log(level, fmt __VA_OPT__(,) __VA_ARGS__);                                       \
+        }                                                                                                \
+    } while (0)
+
+// 编译期最低级别(0 debug, 1 info, 2 warn, 3 error)，低于它的宏展开为空语句，参数不会被求值
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
+#if LOG_MIN_LEVEL <= 0
+#define LOG_DEBUG(fmt, ...) LOG_AT_(0, fmt __VA_OPT__(,) __VA_ARGS__)
+#else
+#define LOG_DEBUG(fmt, ...) do { } while (0)
+#endif
+#if LOG_MIN_LEVEL <= 1
+#define LOG_INFO(fmt, ...) LOG_AT_(1, fmt __VA_OPT__(,) __VA_ARGS__)
+#else
+#define LOG_INFO(fmt, ...) do { } while (0)
+#endif
+#if LOG_MIN_LEVEL <= 2
+#define LOG_WARN(fmt, ...) LOG_AT_(2, fmt __VA_OPT__(,) __VA_ARGS__)
+#else
+#define LOG_WARN(fmt, ...) do { } while (0)
+#endif
+#if LOG_MIN_LEVEL <= 3
+#define LOG_ERROR(fmt, ...) LOG_AT_(3, fmt __VA_OPT__(,) __VA_ARGS__)
+#else
+#define LOG_ERROR(fmt, ...) do { } while (0)
+#endif
+
+bool Log::init(const std::string_view file_name, bool close_log, int log_buf_size, int split_lines, int max_queue_size,
+               log_format format)
 {
-    m_close_log.store(close_log);
-    m_log_buf_size = log_buf_size;
-    m_buf = new char[m_log_buf_size];
-
-    struct timeval now;
-    gettimeofday(&now, nullptr);
-    time_t tSec = now.tv_sec;
-    struct tm *sysTime = localtime(&tSec);
-    struct tm t = *sysTime;
-
-    m_today = mktime(&t);
+    if (close_log) m_levels.fetch_or(kClosedBit);
+    else m_levels.fetch_and(~kClosedBit);
+    m_binary = format == log_format::binary;
+    m_buf_size = std::max<std::size_t>(log_buf_size, kMinLineSpace * 4);
 
     auto path = std::filesystem::path{file_name};
-    m_dir_name = path.parent_path().string();
-    m_log_name = path.filename().string();
-
-    int LOG_NAME_LEN = 126;
-    char fileName[LOG_NAME_LEN] = {0};
-    snprintf(fileName, LOG_NAME_LEN - 1, "%s/%04d_%02d_%02d.log",
-            m_dir_name, t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
-
-    m_fp = fopen(fileName, "a");
-    if (m_fp == NULL) return false;
+    if (!m_file.open(path.parent_path().string(), path.filename().string())) return false;
+    if (m_binary) write_preamble_();
 
     m_split_lines = split_lines;
     m_count = 0;
 
     if (max_queue_size >= 1) {
+        if (!m_pool) {
+            m_pool = std::make_unique<mpmc_queue<log_buffer*, kPoolCapacity>>();
+            for (int i = 0; i < max_queue_size && static_cast<std::size_t>(i) < kPoolCapacity; ++i)
+                m_pool->push(new log_buffer(m_buf_size));
+        }
         m_is_async.store(true);
-        if(!m_log_queue) {
-            unique_ptr<BlockQueue<std::string>> newDeque(new BlockQueue<std::string>);
-            m_log_queue = std::move(newDeque);
-            
-            std::unique_ptr<std::thread> NewThread(new std::thread(&Log::async_write_log, this));
-            m_write_thread = move(NewThread);
+        if (!m_write_thread) {
+            m_write_thread = std::make_unique<std::thread>(&Log::async_write_log, this);
         }
     }
     return true;
@@ -106,109 +276,363 @@ bool Log::init(const std::string_view file_name, bool close_log, int log_buf_siz
 
 Log::~Log()
 {
-    delete[] m_buf;
-    if (m_fp)
-    {
-        fclose(m_fp);
+    if (m_write_thread) {
+        m_stop.store(true, std::memory_order_seq_cst);
+        notify_writer_();
+        m_write_thread->join();
+    }
+    m_producers.clear();
+    if (m_pool) {
+        log_buffer* buf;
+        while (m_pool->try_pop(buf)) delete buf;
     }
+    m_file.close();
 }
 
-template<typename... Args>
-void Log::write_log(int level, const std::string_view fmt, Args&&... args)
+// 写入"[time.usec] [level]: "，返回长度
+// 日期时间部分按线程缓存，跨秒时才重新localtime/strftime，微秒直接按位写出
+std::size_t Log::format_prefix_(char* out, int level)
 {
-    std::scoped_lock lock{m_mutex};
+    struct second_cache {
+        time_t sec = -1;
+        char text[kTimeTextSize];
+    };
+    static thread_local second_cache cache;
 
     struct timeval now;
     gettimeofday(&now, nullptr);
-    time_t tSec = now.tv_sec;
-    struct tm *sysTime = localtime(&tSec);
-    struct tm t = *sysTime;
-
-    time_t today = mktime(&t);
+    if (now.tv_sec != cache.sec) {
+        struct tm t;
+        localtime_r(&now.tv_sec, &t);
+        strftime(cache.text, sizeof(cache.text), "%Y-%m-%d %H:%M:%S", &t);
+        cache.sec = now.tv_sec;
+    }
 
-    if (today != m_today || m_count % m_split_lines == 0)
+    char* p = out;
+    *p++ = '[';
+    p = std::copy(cache.text, cache.text + kTimeTextSize - 1, p);
+    *p++ = '.';
+    for (long us = now.tv_usec, div = 100000; div > 0; us %= div, div /= 10) *p++ = static_cast<char>('0' + us / div);
+    std::string_view tag;
+    switch (level)
     {
-        std::string new_log_name = [&]() {
-            std::stringstream ss;
-            ss << m_dir_name << "/" << today << "_" << m_log_name;
-            if (today != m_today)
-            {
-                m_count = 0;
-            }
-            else
-            {
-                ss << "." << m_count / m_split_lines;
-            }
-            return ss.str();
-        }();
-
-        fclose(m_fp);
-        m_today = today;
-        m_fp = fopen(new_log_name.c_str(), "a");
+    case 0:
+        tag = "] [debug]: ";
+        break;
+    case 2:
+        tag = "] [warn]: ";
+        break;
+    case 3:
+        tag = "] [error]: ";
+        break;
+    default:
+        tag = "] [info]: ";
+        break;
     }
+    p = std::copy(tag.begin(), tag.end(), p);
+    return p - out;
+}
 
-    m_count++;
-
-    char time_buf[32];
-    strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", &t);
-
-    std::string log_str = [&]() {
-        std::stringstream ss;
-        ss << "[" << time_buf << "] ";
-        switch (level)
+// 直接格式化到buf尾部；放不下时返回false且不修改buf，空缓冲区也放不下的超长行会被截断
+template<typename... Args>
+bool Log::append_line_(log_buffer& buf, int level, std::string_view fmt, Args&... args)
+{
+    if (buf.avail() < kMinLineSpace) return false;
+
+    // 只写入[p, end)，同时统计完整长度用于判断是否截断
+    struct bounded_out {
+        using difference_type = std::ptrdiff_t;
+        char* p;
+        char* end;
+        std::size_t n = 0;
+        bounded_out& operator*() noexcept { return *this; }
+        bounded_out& operator++() noexcept { return *this; }
+        bounded_out& operator++(int) noexcept { return *this; }
+        bounded_out& operator=(char c) noexcept
         {
-        case 0:
-            ss << "[debug]: ";
-            break;
-        case 1:
-            ss << "[info]: ";
-            break;
-        case 2:
-            ss << "[warn]: ";
-            break;
-        case 3:
-            ss << "[error]: ";
-            break;
-        default:
-            ss << "[info]: ";
-            break;
+            if (p != end) *p++ = c;
+            ++n;
+            return *this;
         }
-        ss << std::format(fmt, std::forward<Args>(args)...) << '\n';
-        return ss.str();
-    }();
+    };
+
+    char* begin = buf.cur();
+    char* last = begin + buf.avail() - 1;      // 留一个字节给换行
+    std::size_t prefix = format_prefix_(begin, level);
+    bounded_out out = std::vformat_to(bounded_out{begin + prefix, last}, fmt, std::make_format_args(args...));
+    if (out.n > static_cast<std::size_t>(last - begin) - prefix && buf.size() > 0) return false;
+    *out.p++ = '\n';
+    buf.add(out.p - begin);
+    return true;
+}
+
+template<typename... Args>
+void Log::write_log(int level, const std::string_view fmt, Args&&... args)
+{
+    append_([&](log_buffer& buf) { return append_line_(buf, level, fmt, args...); });
+}
 
-    if (m_is_async.load())
+template<typename F>
+void Log::append_(F&& append)
+{
+    if (m_is_async.load(std::memory_order_relaxed))
     {
-        m_log_queue.push(log_str);
+        // 只写本线程的缓冲区，不加锁
+        producer& p = local_producer_();
+        log_buffer* buf = p.active.load(std::memory_order_relaxed);
+        if (!append(*buf)) {
+            buf = swap_buffer_(p);
+            append(*buf);
+        }
+        buf->commit();
+        if (m_durability.load(std::memory_order_relaxed) != log_durability::relaxed) notify_writer_();
     }
     else
     {
-        fputs(log_str.c_str(), m_fp);
+        static thread_local log_buffer line{m_buf_size};
+        line.reset();
+        if (!append(line)) return;
+        iovec iov{line.data(), line.size()};
+        std::scoped_lock lock{m_mutex};
+        write_iov_(&iov, 1);
+        if (m_durability.load(std::memory_order_relaxed) == log_durability::sync) m_file.sync();
     }
 }
 
+template<typename... Args>
+void Log::write_binary(log_binary::site& site, const Args&... args)
+{
+    write_record_(site, log_binary::normalize(args)...);
+}
+
+template<typename... Args>
+void Log::write_record_(log_binary::site& site, const Args&... args)
+{
+    if (!site.registered.load(std::memory_order_acquire)) register_site_<Args...>(site);
+    append_([&](log_buffer& buf) { return append_record_(buf, site, args...); });
+}
+
+template<typename... Args>
+void Log::register_site_(log_binary::site& site)
+{
+    using namespace log_binary;
+    std::string rec(1 + 4 + 1 + 1 + sizeof...(Args) + 4 + site.fmt.size(), '\0');
+    char* p = rec.data();
+    p = put<std::uint8_t>(p, kFormatRecord);
+    p = put<std::uint32_t>(p, site.id);
+    p = put<std::uint8_t>(p, static_cast<std::uint8_t>(site.level));
+    p = put<std::uint8_t>(p, sizeof...(Args));
+    ((p = put<std::uint8_t>(p, static_cast<std::uint8_t>(kind_of<Args>()))), ...);
+    p = put<std::uint32_t>(p, static_cast<std::uint32_t>(site.fmt.size()));
+    std::memcpy(p, site.fmt.data(), site.fmt.size());
+
+    std::lock_guard lock{m_sites_mutex};
+    if (site.registered.load(std::memory_order_relaxed)) return;
+    m_sites.push_back(std::move(rec));
+    site.registered.store(true, std::memory_order_release);
+}
+
+// 一条记录放不进空缓冲区时直接丢弃
+template<typename... Args>
+bool Log::append_record_(log_buffer& buf, const log_binary::site& site, const Args&... args)
+{
+    using namespace log_binary;
+    std::size_t payload = (std::size_t{0} + ... + arg_size(args));
+    if (buf.avail() < kEntryHeaderSize + payload) return false;
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    char* p = buf.cur();
+    p = put<std::uint8_t>(p, kEntryRecord);
+    p = put<std::uint32_t>(p, site.id);
+    p = put<std::uint32_t>(p, static_cast<std::uint32_t>(payload));
+    p = put<std::int64_t>(p, std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+    ((p = put_arg(p, args)), ...);
+    buf.add(kEntryHeaderSize + payload);
+    return true;
+}
+
+Log::producer& Log::local_producer_()
+{
+    if (!t_producer.p) {
+        t_producer.p = std::make_shared<producer>();
+        t_producer.p->active.store(acquire_buffer_(), std::memory_order_release);
+        std::lock_guard lock{m_producers_mutex};
+        m_producers.push_back(t_producer.p);
+        m_producers_version.fetch_add(1, std::memory_order_release);
+    }
+    return *t_producer.p;
+}
+
+// 先换上新缓冲区再交出旧的，写线程看到switching为false时旧缓冲区一定已入队
+log_buffer* Log::swap_buffer_(producer& p)
+{
+    p.switching.store(true, std::memory_order_relaxed);
+    log_buffer* full = p.active.load(std::memory_order_relaxed);
+    log_buffer* buf = acquire_buffer_();
+    p.active.store(buf, std::memory_order_release);
+    p.full.push(full);
+    p.switching.store(false, std::memory_order_release);
+    notify_writer_();
+    return buf;
+}
+
+log_buffer* Log::acquire_buffer_()
+{
+    log_buffer* buf;
+    if (m_pool && m_pool->try_pop(buf)) {
+        buf->reset();
+        return buf;
+    }
+    // 缓冲池用完时临时分配，归还时池满则释放
+    return new log_buffer(m_buf_size);
+}
+
+void Log::release_buffer_(log_buffer* buf)
+{
+    if (!buf) return;
+    if (!m_pool || !m_pool->push(buf)) delete buf;
+}
+
+void Log::notify_writer_() noexcept
+{
+    // 与wait_writer_里的sleepers++配对
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_doorbell_sleepers.load(std::memory_order_relaxed) > 0) {
+        m_doorbell.fetch_add(1, std::memory_order_release);
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_doorbell), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+}
+
+void Log::wait_writer_(int timeout_ms) noexcept
+{
+    uint32_t epoch = m_doorbell.load(std::memory_order_acquire);
+    m_doorbell_sleepers.fetch_add(1, std::memory_order_seq_cst);
+    if (!m_stop.load(std::memory_order_acquire)) {
+        timespec ts{timeout_ms / 1000, static_cast<long>(timeout_ms % 1000) * 1000000};
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_doorbell), FUTEX_WAIT_PRIVATE, epoch, &ts, nullptr, 0);
+    }
+    m_doorbell_sleepers.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void Log::write_preamble_()
+{
+    using namespace log_binary;
+    char header[kHeaderSize];
+    timespec real, mono;
+    clock_gettime(CLOCK_REALTIME, &real);
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    char* p = header;
+    std::memcpy(p, kMagic, sizeof(kMagic));
+    p = put<std::uint32_t>(p + sizeof(kMagic), kVersion);
+    p = put<std::int64_t>(p, real.tv_sec * 1000000000ll + real.tv_nsec);
+    put<std::int64_t>(p, mono.tv_sec * 1000000000ll + mono.tv_nsec);
+    iovec iov{header, sizeof(header)};
+    m_file.write(&iov, 1);
+
+    std::lock_guard lock{m_sites_mutex};
+    m_sites_written = 0;
+    write_new_sites_();
+}
+
+// 调用方持有m_sites_mutex
+void Log::write_new_sites_()
+{
+    m_sites_iov.clear();
+    for (; m_sites_written < m_sites.size(); ++m_sites_written)
+        m_sites_iov.push_back({m_sites[m_sites_written].data(), m_sites[m_sites_written].size()});
+    m_file.write(m_sites_iov.data(), static_cast<int>(m_sites_iov.size()));
+}
+
+// 切分以一批数据为单位，文件可能比split_lines多出不到一批；二进制模式看不到行，只按天和段大小切分
+void Log::write_iov_(iovec* iov, int count)
+{
+    std::size_t bytes = 0;
+    for (int i = 0; i < count; ++i) bytes += iov[i].iov_len;
+    if (m_file.rotate_if_needed(bytes, !m_binary && m_count >= m_split_lines)) {
+        m_count = 0;
+        if (m_binary) write_preamble_();
+    }
+    if (m_binary) {
+        // 本批记录用到的格式串都已在提交记录之前登记
+        std::lock_guard lock{m_sites_mutex};
+        write_new_sites_();
+    } else {
+        for (int i = 0; i < count; ++i) {
+            const char* base = static_cast<const char*>(iov[i].iov_base);
+            m_count += std::count(base, base + iov[i].iov_len, '\n');
+        }
+    }
+    m_file.write(iov, count);
+}
+
 void Log::async_write_log(){
-    while (true){
-        std::unique_lock lock{m_mutex};
-        m_cv.wait(lock, [this]{ return !m_log_queue.empty() || m_close_log.load(); });
+    std::vector<std::shared_ptr<producer>> rings;
+    uint32_t seen_version = ~0u;
+    std::vector<iovec> iov;
+    std::vector<log_buffer*> done;
+
+    auto add = [&](char* base, std::size_t len) {
+        if (len > 0) iov.push_back({base, len});
+    };
+    auto write_out = [&] {
+        for (std::size_t i = 0; i < iov.size(); i += kMaxIov)
+            write_iov_(iov.data() + i, static_cast<int>(std::min<std::size_t>(kMaxIov, iov.size() - i)));
+        if (!iov.empty() && m_durability.load(std::memory_order_relaxed) == log_durability::sync) m_file.sync();
+        for (log_buffer* buf : done) release_buffer_(buf);
+        iov.clear();
+        done.clear();
+    };
 
-        if (m_close_log.load())
-            break;
+    while (true){
+        if (m_producers_version.load(std::memory_order_acquire) != seen_version) {
+            std::lock_guard lock{m_producers_mutex};
+            // 线程已退出且数据已全部写出的生产者可以丢弃，当前缓冲区还给缓冲池
+            std::erase_if(m_producers, [this](const auto& p) {
+                if (!p->exited.load(std::memory_order_acquire) || !p->full.empty()) return false;
+                log_buffer* cur = p->active.load(std::memory_order_acquire);
+                if (cur && (cur == p->reading ? p->consumed : 0) != cur->committed()) return false;
+                release_buffer_(p->active.exchange(nullptr));
+                return true;
+            });
+            rings = m_producers;
+            seen_version = m_producers_version.load(std::memory_order_acquire);
+        }
 
-        while (!m_log_queue.empty())
-        {
-            const auto& log_str = m_log_queue.front();
-            fputs(log_str.c_str(), m_fp);
-            m_log_queue.pop();
+        for (auto& p : rings) {
+            // 先写已交出的满缓冲区，再写当前缓冲区里已提交的部分
+            log_buffer* buf;
+            while (p->full.try_pop(buf)) {
+                std::size_t from = buf == p->reading ? p->consumed : 0;
+                add(buf->data() + from, buf->committed() - from);
+                done.push_back(buf);
+                p->reading = nullptr;
+                p->consumed = 0;
+            }
+            log_buffer* cur = p->active.load(std::memory_order_acquire);
+            // 正在换缓冲区或旧缓冲区还在队列里时，要等下一轮先把旧的写完
+            if (cur && !p->switching.load(std::memory_order_acquire) && p->full.empty()) {
+                if (cur != p->reading) {
+                    p->reading = cur;
+                    p->consumed = 0;
+                }
+                std::size_t committed = cur->committed();
+                add(cur->data() + p->consumed, committed - p->consumed);
+                p->consumed = committed;
+            }
+            if (p->exited.load(std::memory_order_acquire)) m_producers_version.fetch_add(1, std::memory_order_release);
+        }
+        if (!iov.empty() || !done.empty()) {
+            write_out();
+            continue;
         }
 
-        fflush(m_fp);
+        if (m_stop.load(std::memory_order_acquire)) break;
+        wait_writer_(m_flush_interval_ms.load(std::memory_order_relaxed));
     }
 }
 
 void Log::flush(){
-    if(m_is_async.load()) {
-        m_log_queue->flush(); 
-    }
-    fflush(fp_);
+    // 同步模式每行直接write，没有用户态缓冲
+    if (!m_is_async.load()) return;
+    // 文件由写线程独占，唤醒它写出所有已提交的日志
+    notify_writer_();
 }
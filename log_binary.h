@@ -0,0 +1,129 @@
+/*
+ * 二进制日志格式(延迟格式化，参考NanoLog)
+ * 每个LOG_*调用处有一个编译期算出的id，第一次执行时把格式串登记到Log；之后每次调用只写入
+ * id、单调时钟时间戳和参数的原始字节，格式化留给离线的log_decoder完成
+ *
+ * 文件布局(小端，不对齐)：
+ *   文件头   magic[8] version:u32 realtime_ns:i64 steady_ns:i64   两个时钟的锚点，用于换算墙上时间
+ *   格式记录 tag=1 id:u32 level:u8 nargs:u8 kinds[nargs] fmt_len:u32 fmt
+ *   日志记录 tag=2 id:u32 size:u32 steady_ns:i64 args   size为args的字节数
+ * 参数：整数/浮点/bool/char按8或1字节定长存放，字符串为len:u32 + 字节，其他类型在调用处先格式化成字符串
+ * 每个文件都以文件头和全部已登记的格式记录开头，可以单独解码
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace log_binary {
+
+inline constexpr char kMagic[8] = {'C', 'M', 'L', 'O', 'G', 'B', 'I', 'N'};
+inline constexpr std::uint32_t kVersion = 1;
+inline constexpr std::size_t kHeaderSize = 8 + 4 + 8 + 8;
+inline constexpr std::size_t kEntryHeaderSize = 1 + 4 + 4 + 8;
+
+enum record_tag : std::uint8_t { kFormatRecord = 1, kEntryRecord = 2 };
+
+enum class arg_kind : std::uint8_t { i64 = 1, u64, f64, boolean, character, string };
+
+constexpr std::uint32_t fnv1a(std::string_view s, std::uint32_t h = 2166136261u)
+{
+    for (char c : s) {
+        h ^= static_cast<std::uint8_t>(c);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// 调用处的id：文件名、行号和格式串的哈希
+constexpr std::uint32_t site_id(std::string_view file, int line, std::string_view fmt)
+{
+    std::uint32_t h = (fnv1a(file) ^ static_cast<std::uint32_t>(line)) * 16777619u;
+    return fnv1a(fmt, h);
+}
+
+// 每个调用处一个，静态常量初始化，不需要加锁
+struct site
+{
+    std::uint32_t id;
+    int level;
+    std::string_view fmt;
+    std::atomic<bool> registered{false};
+};
+
+template <typename T>
+constexpr arg_kind kind_of()
+{
+    using U = std::remove_cvref_t<T>;
+    if constexpr (std::is_same_v<U, bool>) return arg_kind::boolean;
+    else if constexpr (std::is_same_v<U, char>) return arg_kind::character;
+    else if constexpr (std::is_enum_v<U>) return std::is_signed_v<std::underlying_type_t<U>> ? arg_kind::i64 : arg_kind::u64;
+    else if constexpr (std::is_integral_v<U>) return std::is_signed_v<U> ? arg_kind::i64 : arg_kind::u64;
+    else if constexpr (std::is_floating_point_v<U>) return arg_kind::f64;
+    else return arg_kind::string;
+}
+
+// 不能直接存放的类型在调用处格式化成字符串，其余原样传递
+template <typename T>
+decltype(auto) normalize(const T& v)
+{
+    if constexpr (kind_of<T>() != arg_kind::string || std::is_convertible_v<const T&, std::string_view>) return (v);
+    else if constexpr (std::is_pointer_v<T>) return reinterpret_cast<std::uintptr_t>(v);
+    else return std::vformat("{}", std::make_format_args(v));
+}
+
+template <typename T>
+std::size_t arg_size(const T& v)
+{
+    constexpr arg_kind k = kind_of<T>();
+    if constexpr (k == arg_kind::boolean || k == arg_kind::character) return 1;
+    else if constexpr (k == arg_kind::string) {
+        if constexpr (std::is_pointer_v<std::decay_t<T>>) return 4 + (v ? std::strlen(v) : 0);
+        else return 4 + std::string_view{v}.size();
+    }
+    else return 8;
+}
+
+template <typename T>
+char* put_arg(char* p, const T& v)
+{
+    constexpr arg_kind k = kind_of<T>();
+    if constexpr (k == arg_kind::boolean || k == arg_kind::character) {
+        *p = static_cast<char>(v);
+        return p + 1;
+    } else if constexpr (k == arg_kind::i64) {
+        auto x = static_cast<std::int64_t>(v);
+        std::memcpy(p, &x, 8);
+        return p + 8;
+    } else if constexpr (k == arg_kind::u64) {
+        auto x = static_cast<std::uint64_t>(v);
+        std::memcpy(p, &x, 8);
+        return p + 8;
+    } else if constexpr (k == arg_kind::f64) {
+        auto x = static_cast<double>(v);
+        std::memcpy(p, &x, 8);
+        return p + 8;
+    } else {
+        std::string_view s;
+        if constexpr (std::is_pointer_v<std::decay_t<T>>) s = v ? std::string_view{v} : std::string_view{};
+        else s = v;
+        auto n = static_cast<std::uint32_t>(s.size());
+        std::memcpy(p, &n, 4);
+        std::memcpy(p + 4, s.data(), n);
+        return p + 4 + n;
+    }
+}
+
+template <typename T>
+char* put(char* p, T v)
+{
+    std::memcpy(p, &v, sizeof(v));
+    return p + sizeof(v);
+}
+
+} // namespace log_binary
@@ -0,0 +1,273 @@
+/*
+ * 二进制日志解码工具，把Log以log_format::binary写出的文件还原成文本日志
+ * 用法：log_decoder <file>...  结果输出到stdout，格式与文本模式相同
+ */
+#include <stdio.h>
+#include <time.h>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "log_binary.h"
+
+using namespace log_binary;
+
+struct format_record
+{
+    int level;
+    std::vector<arg_kind> kinds;
+    std::string fmt;
+};
+
+struct arg_value
+{
+    arg_kind kind;
+    std::int64_t i;
+    std::uint64_t u;
+    double f;
+    std::string_view s;
+};
+
+class reader
+{
+public:
+    reader(const char* p, std::size_t n) : m_p{p}, m_end{p + n} {}
+
+    bool empty() const { return m_p == m_end; }
+    std::size_t left() const { return static_cast<std::size_t>(m_end - m_p); }
+    const char* pos() const { return m_p; }
+
+    template<typename T>
+    bool get(T& v)
+    {
+        if (left() < sizeof(T)) return false;
+        std::memcpy(&v, m_p, sizeof(T));
+        m_p += sizeof(T);
+        return true;
+    }
+
+    bool bytes(std::size_t n, std::string_view& out)
+    {
+        if (left() < n) return false;
+        out = {m_p, n};
+        m_p += n;
+        return true;
+    }
+
+private:
+    const char* m_p;
+    const char* m_end;
+};
+
+static std::string format_one(std::string_view spec, const arg_value& a)
+{
+    std::string f = "{";
+    if (!spec.empty()) f.append(":").append(spec);
+    f += "}";
+    switch (a.kind)
+    {
+    case arg_kind::i64:
+        return std::vformat(f, std::make_format_args(a.i));
+    case arg_kind::u64:
+        return std::vformat(f, std::make_format_args(a.u));
+    case arg_kind::f64:
+        return std::vformat(f, std::make_format_args(a.f));
+    case arg_kind::boolean: {
+        bool b = a.u != 0;
+        return std::vformat(f, std::make_format_args(b));
+    }
+    case arg_kind::character: {
+        char c = static_cast<char>(a.u);
+        return std::vformat(f, std::make_format_args(c));
+    }
+    default:
+        return std::vformat(f, std::make_format_args(a.s));
+    }
+}
+
+// 逐个处理替换域，支持{{ }}转义、显式下标和格式说明
+static std::string format_message(std::string_view fmt, const std::vector<arg_value>& args)
+{
+    std::string out;
+    std::size_t next = 0;
+    for (std::size_t i = 0; i < fmt.size(); ++i)
+    {
+        char c = fmt[i];
+        if ((c == '{' || c == '}') && i + 1 < fmt.size() && fmt[i + 1] == c) {
+            out += c;
+            ++i;
+            continue;
+        }
+        if (c != '{') {
+            out += c;
+            continue;
+        }
+        std::size_t close = fmt.find('}', i);
+        if (close == std::string_view::npos) {
+            out.append(fmt.substr(i));
+            break;
+        }
+        std::string_view field = fmt.substr(i + 1, close - i - 1);
+        std::size_t colon = field.find(':');
+        std::string_view index = field.substr(0, colon);
+        std::string_view spec = colon == std::string_view::npos ? std::string_view{} : field.substr(colon + 1);
+        std::size_t n = index.empty() ? next++ : std::stoul(std::string{index});
+        if (n < args.size()) out += format_one(spec, args[n]);
+        else out.append(fmt.substr(i, close - i + 1));
+        i = close;
+    }
+    return out;
+}
+
+static const char* level_tag(int level)
+{
+    switch (level)
+    {
+    case 0:
+        return "debug";
+    case 2:
+        return "warn";
+    case 3:
+        return "error";
+    default:
+        return "info";
+    }
+}
+
+static bool decode(const std::string& data, FILE* out)
+{
+    std::unordered_map<std::uint32_t, format_record> formats;
+    std::int64_t realtime_ns = 0, steady_ns = 0;
+    bool has_header = false;
+    reader r{data.data(), data.size()};
+    std::vector<arg_value> args;
+
+    while (!r.empty())
+    {
+        // 以追加方式重新打开的文件中间可能再出现一个文件头
+        if (r.left() >= sizeof(kMagic) && std::memcmp(r.pos(), kMagic, sizeof(kMagic)) == 0)
+        {
+            std::string_view magic;
+            std::uint32_t version;
+            r.bytes(sizeof(kMagic), magic);
+            if (!r.get(version) || version != kVersion || !r.get(realtime_ns) || !r.get(steady_ns)) {
+                fprintf(stderr, "bad header\n");
+                return false;
+            }
+            has_header = true;
+            continue;
+        }
+        if (!has_header) {
+            fprintf(stderr, "not a binary log\n");
+            return false;
+        }
+
+        // 进程崩溃时文件尾部是预分配的0字节
+        if (*r.pos() == 0) break;
+        std::uint8_t tag;
+        std::uint32_t id;
+        if (!r.get(tag) || !r.get(id)) break;
+        if (tag == kFormatRecord)
+        {
+            format_record rec;
+            std::uint8_t level, nargs;
+            std::uint32_t len;
+            std::string_view kinds, fmt;
+            if (!r.get(level) || !r.get(nargs) || !r.bytes(nargs, kinds) || !r.get(len) || !r.bytes(len, fmt)) break;
+            rec.level = level;
+            for (char k : kinds) rec.kinds.push_back(static_cast<arg_kind>(k));
+            rec.fmt = fmt;
+            formats[id] = std::move(rec);
+        }
+        else if (tag == kEntryRecord)
+        {
+            std::uint32_t size;
+            std::int64_t ts;
+            std::string_view payload;
+            if (!r.get(size) || !r.get(ts) || !r.bytes(size, payload)) break;
+            auto it = formats.find(id);
+            if (it == formats.end()) {
+                fprintf(stderr, "unknown format id %08x\n", id);
+                continue;
+            }
+
+            args.clear();
+            reader pr{payload.data(), payload.size()};
+            for (arg_kind k : it->second.kinds)
+            {
+                arg_value a{k, 0, 0, 0.0, {}};
+                bool ok = true;
+                switch (k)
+                {
+                case arg_kind::i64:
+                    ok = pr.get(a.i);
+                    break;
+                case arg_kind::u64:
+                    ok = pr.get(a.u);
+                    break;
+                case arg_kind::f64:
+                    ok = pr.get(a.f);
+                    break;
+                case arg_kind::boolean:
+                case arg_kind::character: {
+                    std::uint8_t b;
+                    ok = pr.get(b);
+                    a.u = b;
+                    break;
+                }
+                default: {
+                    std::uint32_t n;
+                    ok = pr.get(n) && pr.bytes(n, a.s);
+                    break;
+                }
+                }
+                if (!ok) break;
+                args.push_back(a);
+            }
+
+            // 用文件头的两个锚点把单调时钟换算成墙上时间
+            std::int64_t wall = realtime_ns + (ts - steady_ns);
+            time_t sec = wall / 1000000000;
+            struct tm t;
+            localtime_r(&sec, &t);
+            char when[32];
+            strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &t);
+            std::string msg = format_message(it->second.fmt, args);
+            fprintf(out, "[%s.%06lld] [%s]: %s\n", when, static_cast<long long>(wall % 1000000000 / 1000),
+                    level_tag(it->second.level), msg.c_str());
+        }
+        else
+        {
+            fprintf(stderr, "bad record tag %u\n", tag);
+            return false;
+        }
+    }
+    // 进程崩溃时最后一条记录可能不完整，忽略即可
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <file>...\n", argv[0]);
+        return 1;
+    }
+    int ret = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::ifstream in{argv[i], std::ios::binary};
+        if (!in) {
+            fprintf(stderr, "%s: cannot open\n", argv[i]);
+            ret = 1;
+            continue;
+        }
+        std::string data{std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+        if (!decode(data, stdout)) ret = 1;
+    }
+    return ret;
+}
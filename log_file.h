@@ -0,0 +1,332 @@
+/*
+ * 日志文件：按段预分配并mmap，写入只是memcpy到映射区
+ * 数据写进映射区后就在page cache里，进程崩溃不会丢失；段写满或跨天时切到后台线程提前打开好的下一段，
+ * 旧段的munmap/ftruncate/close也交给后台线程，写日志的线程不做open/close
+ * 文件名为 dir/YYYY_MM_DD_name[.part]，已存在的文件不会被续写，而是顺延到下一个part
+ * 进程崩溃时最后一段的尾部是预分配的0字节
+ */
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+class log_segment
+{
+public:
+    log_segment() = default;
+    ~log_segment() { close(); }
+    log_segment(const log_segment&) = delete;
+    log_segment& operator=(const log_segment&) = delete;
+    log_segment(log_segment&& other) noexcept { *this = std::move(other); }
+    log_segment& operator=(log_segment&& other) noexcept
+    {
+        if (this != &other) {
+            close();
+            m_fd = std::exchange(other.m_fd, -1);
+            m_base = std::exchange(other.m_base, nullptr);
+            m_capacity = std::exchange(other.m_capacity, 0);
+            m_size = std::exchange(other.m_size, 0);
+            m_synced = std::exchange(other.m_synced, 0);
+            m_path = std::move(other.m_path);
+            m_day = other.m_day;
+            m_part = other.m_part;
+        }
+        return *this;
+    }
+
+    // 新建文件(已存在时失败)并预分配capacity字节
+    bool open(const std::string& path, std::size_t capacity, time_t day, long long part)
+    {
+        close();
+        m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (m_fd < 0) return false;
+        m_path = path;
+        m_day = day;
+        m_part = part;
+        if (!map_(capacity)) {
+            remove();
+            return false;
+        }
+        return true;
+    }
+
+    // 关闭并删除文件，用于从未写入的段
+    void remove()
+    {
+        bool opened = is_open();
+        close();
+        if (opened) unlink(m_path.c_str());
+    }
+
+    bool is_open() const noexcept { return m_fd >= 0; }
+    std::size_t size() const noexcept { return m_size; }
+    std::size_t remaining() const noexcept { return m_capacity - m_size; }
+    time_t day() const noexcept { return m_day; }
+    long long part() const noexcept { return m_part; }
+
+    // 放不下时扩大映射，只在一批数据比整段还大时发生
+    bool reserve(std::size_t n)
+    {
+        if (n <= remaining()) return true;
+        std::size_t capacity = std::max(m_capacity * 2, m_size + n);
+        return map_(capacity);
+    }
+
+    bool write(const iovec* iov, int count)
+    {
+        std::size_t total = 0;
+        for (int i = 0; i < count; ++i) total += iov[i].iov_len;
+        if (!reserve(total)) return false;
+        for (int i = 0; i < count; ++i) {
+            std::memcpy(m_base + m_size, iov[i].iov_base, iov[i].iov_len);
+            m_size += iov[i].iov_len;
+        }
+        return true;
+    }
+
+    // 把上次之后写入的部分刷到磁盘
+    void sync()
+    {
+        if (!m_base || m_synced == m_size) return;
+        static const std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        std::size_t from = m_synced & ~(page - 1);
+        msync(m_base + from, m_size - from, MS_SYNC);
+        m_synced = m_size;
+    }
+
+    // 截掉未用的预分配部分
+    void close()
+    {
+        if (m_base) munmap(m_base, m_capacity);
+        if (m_fd >= 0) {
+            ftruncate(m_fd, static_cast<off_t>(m_size));
+            ::close(m_fd);
+        }
+        m_base = nullptr;
+        m_fd = -1;
+        m_capacity = m_size = m_synced = 0;
+    }
+
+private:
+    bool map_(std::size_t capacity)
+    {
+        int err = fallocate(m_fd, 0, 0, static_cast<off_t>(capacity));
+        if (err != 0 && (errno != EOPNOTSUPP || ftruncate(m_fd, static_cast<off_t>(capacity)) != 0)) return false;
+        void* p;
+        if (m_base) p = mremap(m_base, m_capacity, capacity, MREMAP_MAYMOVE);
+        else p = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, 0);
+        if (p == MAP_FAILED) return false;
+        m_base = static_cast<char*>(p);
+        m_capacity = capacity;
+        return true;
+    }
+
+    std::string m_path;
+    int m_fd = -1;
+    char* m_base = nullptr;
+    std::size_t m_capacity = 0;
+    std::size_t m_size = 0;
+    std::size_t m_synced = 0;
+    time_t m_day = 0;
+    long long m_part = 0;
+};
+
+class log_file
+{
+public:
+    static constexpr std::size_t kDefaultSegmentSize = 64 * 1024 * 1024;
+
+    log_file() = default;
+    ~log_file() { close(); }
+    log_file(const log_file&) = delete;
+    log_file& operator=(const log_file&) = delete;
+
+    // 同步打开当天的第一段并启动后台线程
+    bool open(std::string dir, std::string name)
+    {
+        close();
+        m_dir = std::move(dir);
+        m_name = std::move(name);
+        time_t now = time(nullptr);
+        m_today = day_start_(now);
+        m_tomorrow = next_day_(m_today);
+        if (!open_segment_(m_current, m_today, 0)) return false;
+        m_wanted_day = m_today;
+        m_wanted_part = m_current.part() + 1;
+        m_stop = false;
+        m_thread = std::thread(&log_file::prepare_loop_, this);
+        return true;
+    }
+
+    void close()
+    {
+        if (m_thread.joinable()) {
+            {
+                std::lock_guard lock{m_mutex};
+                m_stop = true;
+            }
+            m_cv.notify_one();
+            m_thread.join();
+        }
+        m_current.close();
+        m_next.remove();
+        m_retired.clear();
+    }
+
+    bool is_open() const noexcept { return m_current.is_open(); }
+
+    // 之后打开的段使用新的大小
+    void set_segment_size(std::size_t bytes)
+    {
+        std::lock_guard lock{m_mutex};
+        m_segment_size = bytes;
+    }
+
+    // 跨天、当前段放不下bytes或force时换到下一段，换了返回true
+    bool rotate_if_needed(std::size_t bytes, bool force)
+    {
+        time_t now = time(nullptr);
+        if (now < m_tomorrow && !force && bytes <= m_current.remaining()) return false;
+
+        time_t day = m_today;
+        long long part = m_current.part() + 1;
+        if (now >= m_tomorrow) {
+            day = day_start_(now);
+            part = 0;
+        }
+
+        log_segment next;
+        {
+            std::lock_guard lock{m_mutex};
+            if (m_next.is_open() && m_next.day() == day) next = std::move(m_next);
+            m_retired.push_back(std::move(m_current));
+            m_wanted_day = day;
+            m_wanted_part = (next.is_open() ? next.part() : part) + 1;
+        }
+        // 后台还没准备好时只能在这里打开
+        if (!next.is_open()) open_segment_(next, day, part);
+        m_current = std::move(next);
+        m_today = day;
+        m_tomorrow = next_day_(day);
+        m_cv.notify_one();
+        return true;
+    }
+
+    bool write(const iovec* iov, int count) { return m_current.is_open() && m_current.write(iov, count); }
+    void sync() { m_current.sync(); }
+
+private:
+    static time_t day_start_(time_t now)
+    {
+        struct tm t;
+        localtime_r(&now, &t);
+        t.tm_hour = t.tm_min = t.tm_sec = 0;
+        return mktime(&t);
+    }
+
+    static time_t next_day_(time_t day)
+    {
+        struct tm t;
+        localtime_r(&day, &t);
+        ++t.tm_mday;
+        t.tm_isdst = -1;
+        return mktime(&t);
+    }
+
+    std::string make_file_name_(time_t day, long long part) const
+    {
+        struct tm t;
+        localtime_r(&day, &t);
+        std::stringstream ss;
+        ss << m_dir << "/" << std::put_time(&t, "%Y_%m_%d") << "_" << m_name;
+        if (part > 0) ss << "." << part;
+        return ss.str();
+    }
+
+    // 从part开始找第一个不存在的文件名
+    bool open_segment_(log_segment& seg, time_t day, long long part)
+    {
+        std::size_t size;
+        {
+            std::lock_guard lock{m_mutex};
+            size = m_segment_size;
+        }
+        for (int tries = 0; tries < 1024; ++tries, ++part) {
+            if (seg.open(make_file_name_(day, part), size, day, part)) return true;
+            if (errno != EEXIST) return false;
+        }
+        return false;
+    }
+
+    // 后台线程：关闭换下来的段，预先打开下一段；接近零点时改为准备第二天的第一段
+    void prepare_loop_()
+    {
+        std::unique_lock lock{m_mutex};
+        while (!m_stop) {
+            std::vector<log_segment> retired = std::move(m_retired);
+            m_retired.clear();
+            time_t day = m_wanted_day;
+            long long part = m_wanted_part;
+            time_t tomorrow = next_day_(day);
+            bool day_ahead = time(nullptr) + kDayAheadSec >= tomorrow;
+            if (day_ahead) {
+                day = tomorrow;
+                part = 0;
+            }
+            bool need = !m_next.is_open() || m_next.day() != day;
+            lock.unlock();
+
+            retired.clear();
+            log_segment seg;
+            bool opened = need && open_segment_(seg, day, part);
+
+            lock.lock();
+            if (opened) {
+                std::swap(seg, m_next);
+                // 换下来的是没写过数据的空段
+                if (seg.is_open()) seg.remove();
+                continue;
+            }
+            if (!m_retired.empty() || m_stop) continue;
+            // 打开失败时稍后重试
+            if (need) m_cv.wait_for(lock, std::chrono::seconds(1));
+            else if (day_ahead) m_cv.wait(lock);
+            else m_cv.wait_until(lock, std::chrono::system_clock::from_time_t(tomorrow - kDayAheadSec));
+        }
+    }
+
+    static constexpr time_t kDayAheadSec = 60;
+
+    std::string m_dir;
+    std::string m_name;
+    // 以下只由写入方访问
+    log_segment m_current;
+    time_t m_today = 0;
+    time_t m_tomorrow = 0;
+    // 以下由m_mutex保护
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    log_segment m_next;
+    std::vector<log_segment> m_retired;
+    time_t m_wanted_day = 0;
+    long long m_wanted_part = 1;
+    std::size_t m_segment_size = kDefaultSegmentSize;
+    bool m_stop = false;
+    std::thread m_thread;
+};
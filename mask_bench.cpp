@@ -0,0 +1,79 @@
+/*
+ * WebSocket掩码内核的吞吐：对一段起点故意不对齐(+1字节)的多MiB缓冲区反复原地异或
+ * 分别测websocket_mask里的每个内核(按字节、8字节标量、SSE2/AVX2/AVX-512中CPU支持的)和apply的分派结果，
+ * 每个内核先在同一段数据上和按字节的结果逐字节比对，载荷偏移取3，覆盖key旋转
+ * 用法：mask_bench [缓冲区MiB=8] [每个内核的轮数=50]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "websocket_mask.h"
+
+constexpr std::uint32_t kKey = 0x37fa213d;
+constexpr std::size_t kOffset = 3;
+
+struct Kernel {
+    const char* name;
+    websocket_mask::MaskFn fn;   // 为空时走apply
+};
+
+void run_kernel(const Kernel& k, std::uint8_t* p, std::size_t n)
+{
+    if (k.fn) k.fn(p, n, websocket_mask::rotateKey(kKey, kOffset));
+    else websocket_mask::apply({p, n}, kKey, kOffset);
+}
+
+bool check(const Kernel& k, const std::vector<std::uint8_t>& input, std::size_t n)
+{
+    std::vector<std::uint8_t> want(input.begin(), input.begin() + n + 1);
+    std::vector<std::uint8_t> got = want;
+    websocket_mask::maskBytes(want.data() + 1, n, websocket_mask::rotateKey(kKey, kOffset));
+    run_kernel(k, got.data() + 1, n);
+    return want == got;
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t mib = argc > 1 ? strtoull(argv[1], nullptr, 10) : 8;
+    int rounds = argc > 2 ? atoi(argv[2]) : 50;
+    if (mib == 0) mib = 1;
+    if (rounds <= 0) rounds = 1;
+    std::size_t n = mib << 20;
+
+    std::vector<std::uint8_t> buf(n + 64);
+    for (std::size_t i = 0; i < buf.size(); ++i) buf[i] = static_cast<std::uint8_t>(i * 131 + 7);
+    // new出来的内存至少16字节对齐，+1后每个内核都要先处理不对齐的开头
+    std::uint8_t* p = buf.data() + 1;
+
+    std::vector<Kernel> kernels{{"bytewise", websocket_mask::maskBytes}, {"scalar64", websocket_mask::maskScalar}};
+#ifdef WEBSOCKET_MASK_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) kernels.push_back({"sse2", websocket_mask::maskSse2});
+    if (__builtin_cpu_supports("avx2")) kernels.push_back({"avx2", websocket_mask::maskAvx2});
+    if (__builtin_cpu_supports("avx512bw")) kernels.push_back({"avx512", websocket_mask::maskAvx512});
+#endif
+    kernels.push_back({"apply", nullptr});
+
+    printf("%zu MiB buffer at +1 byte, payload offset %zu, %d rounds\n", mib, kOffset, rounds);
+    printf("%10s %10s\n", "kernel", "GB/s");
+    for (const Kernel& k : kernels) {
+        // 各种长度的尾部(包括小于一个向量的)都要和按字节的结果一致
+        for (std::size_t len : {std::size_t{0}, std::size_t{1}, std::size_t{15}, std::size_t{63}, std::size_t{64},
+                                std::size_t{65}, std::size_t{4099}, n}) {
+            if (!check(k, buf, len)) {
+                fprintf(stderr, "%s: mismatch at length %zu\n", k.name, len);
+                return 1;
+            }
+        }
+        run_kernel(k, p, n);
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; ++r) run_kernel(k, p, n);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        printf("%10s %10.2f\n", k.name, static_cast<double>(n) * rounds / elapsed.count() / 1e9);
+    }
+    return 0;
+}
@@ -0,0 +1,222 @@
+/*
+ * block_queue的无锁版本：有界多生产者多消费者环形队列(每个槽位带序号，Vyukov算法)
+ * push/pop/超时pop与block_queue一致，另外提供try_push_bulk/try_pop_bulk一次搬运多个元素
+ * 只有队列为空时消费者才会在futex上休眠，生产者仅在有人休眠时才发起唤醒
+ */
+#pragma once
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <optional>
+#include <utility>
+
+template <typename T, std::size_t N>
+class mpmc_queue
+{
+    static_assert(N > 0, "mpmc_queue capacity must be positive");
+
+public:
+    mpmc_queue() : m_slots{new slot[N]}
+    {
+        for (std::size_t i = 0; i < N; ++i) m_slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    ~mpmc_queue() { close(); }
+
+    mpmc_queue(const mpmc_queue&) = delete;
+    mpmc_queue& operator=(const mpmc_queue&) = delete;
+
+    // 唤醒所有等待中的消费者，之后阻塞的pop直接返回false
+    void close() noexcept
+    {
+        m_is_close.store(true, std::memory_order_seq_cst);
+        wake_(INT_MAX);
+    }
+
+    bool full() const noexcept { return size() >= N; }
+    bool empty() const noexcept { return size() == 0; }
+
+    // 并发修改时只是近似值
+    std::size_t size() const noexcept
+    {
+        std::size_t tail = m_enqueue_pos.load(std::memory_order_relaxed);
+        std::size_t head = m_dequeue_pos.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    std::size_t max_size() const noexcept { return N; }
+
+    // 队列满时返回false，不阻塞
+    bool push(const T& item) { return emplace_(item); }
+    bool push(T&& item) { return emplace_(std::move(item)); }
+
+    bool try_pop(T& item)
+    {
+        std::size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            slot& s = m_slots[pos % N];
+            std::size_t seq = s.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    item = std::move(s.value);
+                    s.seq.store(pos + N, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // 阻塞直到取到元素；队列关闭时返回false
+    bool pop(T& item)
+    {
+        while (true) {
+            if (try_pop(item)) return true;
+            if (m_is_close.load(std::memory_order_acquire)) return false;
+            if (!park_(nullptr)) return false;
+        }
+    }
+
+    // timeout为0时不等待
+    bool pop(T& item, std::chrono::milliseconds timeout)
+    {
+        if (try_pop(item)) return true;
+        if (timeout.count() <= 0) return false;
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (true) {
+            auto left = deadline - std::chrono::steady_clock::now();
+            if (left <= left.zero() || m_is_close.load(std::memory_order_acquire)) return try_pop(item);
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(left).count();
+            timespec ts{static_cast<time_t>(ns / 1000000000), static_cast<long>(ns % 1000000000)};
+            park_(&ts);
+            if (try_pop(item)) return true;
+        }
+    }
+
+    // 从first开始尽量入队count个元素(移动)，返回实际入队数量
+    template <typename It>
+    std::size_t try_push_bulk(It first, std::size_t count)
+    {
+        if (count == 0) return 0;
+        std::size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        std::size_t n;
+        while (true) {
+            n = 0;
+            while (n < count && n < N && m_slots[(pos + n) % N].seq.load(std::memory_order_acquire) == pos + n) ++n;
+            if (n == 0) {
+                // 第一个槽位不可用：若是被别人抢先则重试，否则队列已满
+                std::size_t seq = m_slots[pos % N].seq.load(std::memory_order_acquire);
+                if (static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos) < 0) return 0;
+                pos = m_enqueue_pos.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (m_enqueue_pos.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) break;
+        }
+        for (std::size_t i = 0; i < n; ++i, ++first) {
+            slot& s = m_slots[(pos + i) % N];
+            s.value = std::move(*first);
+            s.seq.store(pos + i + 1, std::memory_order_release);
+        }
+        notify_();
+        return n;
+    }
+
+    // 最多取出count个元素写入out，返回实际数量，不阻塞
+    template <typename OutIt>
+    std::size_t try_pop_bulk(OutIt out, std::size_t count)
+    {
+        if (count == 0) return 0;
+        std::size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        std::size_t n;
+        while (true) {
+            n = 0;
+            while (n < count && n < N && m_slots[(pos + n) % N].seq.load(std::memory_order_acquire) == pos + n + 1) ++n;
+            if (n == 0) {
+                std::size_t seq = m_slots[pos % N].seq.load(std::memory_order_acquire);
+                if (static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1) < 0) return 0;
+                pos = m_dequeue_pos.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (m_dequeue_pos.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) break;
+        }
+        for (std::size_t i = 0; i < n; ++i, ++out) {
+            slot& s = m_slots[(pos + i) % N];
+            *out = std::move(s.value);
+            s.seq.store(pos + i + N, std::memory_order_release);
+        }
+        return n;
+    }
+
+private:
+    struct alignas(64) slot {
+        std::atomic<std::size_t> seq;
+        T value{};
+    };
+
+    template <typename U>
+    bool emplace_(U&& item)
+    {
+        std::size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            slot& s = m_slots[pos % N];
+            std::size_t seq = s.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (diff == 0) {
+                if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    s.value = std::forward<U>(item);
+                    s.seq.store(pos + 1, std::memory_order_release);
+                    notify_();
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void notify_() noexcept
+    {
+        // 与park_里的waiters++配对
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_waiters.load(std::memory_order_relaxed) > 0) wake_(1);
+    }
+
+    void wake_(int count) noexcept
+    {
+        m_futex.fetch_add(1, std::memory_order_release);
+        syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&m_futex), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+    }
+
+    // 登记为等待者后再检查一次，确认仍为空才休眠；ts为相对超时
+    bool park_(const timespec* ts) noexcept
+    {
+        std::uint32_t epoch = m_futex.load(std::memory_order_acquire);
+        m_waiters.fetch_add(1, std::memory_order_seq_cst);
+        if (empty() && !m_is_close.load(std::memory_order_acquire)) {
+            syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&m_futex), FUTEX_WAIT_PRIVATE, epoch, ts, nullptr, 0);
+        }
+        m_waiters.fetch_sub(1, std::memory_order_relaxed);
+        return !m_is_close.load(std::memory_order_acquire) || !empty();
+    }
+
+    std::unique_ptr<slot[]> m_slots;
+    alignas(64) std::atomic<std::size_t> m_enqueue_pos{0};
+    alignas(64) std::atomic<std::size_t> m_dequeue_pos{0};
+    alignas(64) std::atomic<std::uint32_t> m_futex{0};
+    std::atomic<std::uint32_t> m_waiters{0};
+    std::atomic<bool> m_is_close{false};
+};
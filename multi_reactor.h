@@ -0,0 +1,239 @@
+#ifndef MULTI_REACTOR_H
+#define MULTI_REACTOR_H
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <assert.h>
+
+#include "event_loop.h"
+
+// 新连接分发策略
+enum class DispatchMode {
+    ReusePort,   // 每个子reactor各自监听同一端口(SO_REUSEPORT)，由内核做负载均衡
+    RoundRobin   // 单独的acceptor loop接受连接，轮询交给子reactor
+};
+
+/*
+ * 主从reactor：每个线程一个EventLoop(各自的Poller + 定时器)，
+ * 连接建立后所有事件都在其所属loop内处理，不再跨线程转交
+ */
+class MultiReactor {
+public:
+    // 在连接所属loop的线程中回调，fd已设置为非阻塞
+    using ConnectionCallback = std::function<void(EventLoop& loop, int fd)>;
+
+    explicit MultiReactor(uint16_t port,
+                          std::size_t threadCount = std::thread::hardware_concurrency(),
+                          DispatchMode mode = DispatchMode::ReusePort,
+                          PollerBackend backend = PollerBackend::Epoll)
+        : m_port{port}, m_threadCount{threadCount > 0 ? threadCount : 1}, m_mode{mode}, m_backend{backend} {}
+
+    ~MultiReactor() { Stop(); }
+
+    MultiReactor(const MultiReactor&) = delete;
+    MultiReactor& operator=(const MultiReactor&) = delete;
+
+    void SetConnectionCallback(ConnectionCallback cb) { m_connCb = std::move(cb); }
+
+    // 监听失败返回false，成功后所有loop都已在运行
+    bool Start() {
+        assert(!m_started);
+        std::size_t listenCount = m_mode == DispatchMode::ReusePort ? m_threadCount : 1;
+        for (std::size_t i = 0; i < listenCount; ++i) {
+            int fd = CreateListenFd(m_port, m_mode == DispatchMode::ReusePort);
+            if (fd < 0) {
+                CloseListenFds_();
+                return false;
+            }
+            m_listenFds.push_back(fd);
+        }
+
+        m_loops.assign(m_threadCount, nullptr);
+        for (std::size_t i = 0; i < m_threadCount; ++i) {
+            int listenFd = m_mode == DispatchMode::ReusePort ? m_listenFds[i] : -1;
+            m_threads.emplace_back([this, i, listenFd] { RunLoop_(listenFd, &m_loops[i]); });
+        }
+        WaitRunning_();
+        // 子reactor全部就绪后再开始accept
+        if (m_mode == DispatchMode::RoundRobin) {
+            m_threads.emplace_back([this] { RunLoop_(m_listenFds[0], &m_acceptor); });
+            WaitRunning_();
+        }
+        m_started = true;
+        return true;
+    }
+
+    void Stop() {
+        if (!m_started) return;
+        m_stopping.store(true, std::memory_order_release);
+        // 先停acceptor：子reactor的EventLoop在各自线程的栈上，线程退出后不能再往里投递
+        if (m_acceptor) {
+            m_acceptor->Quit();
+            m_threads.back().join();
+            m_threads.pop_back();
+            m_acceptor = nullptr;
+        }
+        std::vector<EventLoop*> loops;
+        loops.swap(m_loops);
+        for (auto* loop : loops) loop->Quit();
+        for (auto& t : m_threads) t.join();
+        m_threads.clear();
+        m_running = 0;
+        m_stopping.store(false, std::memory_order_relaxed);
+        CloseListenFds_();
+        m_started = false;
+    }
+
+    std::size_t LoopCount() const noexcept { return m_loops.size(); }
+    EventLoop* GetLoop(std::size_t i) const noexcept { return i < m_loops.size() ? m_loops[i] : nullptr; }
+
+    static int CreateListenFd(uint16_t port, bool reusePort) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (reusePort && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+            close(fd);
+            return -1;
+        }
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port);
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+private:
+    void WaitRunning_() {
+        std::unique_lock lock{m_mutex};
+        m_cond.wait(lock, [this] { return m_running == m_threads.size(); });
+    }
+
+    void RunLoop_(int listenFd, EventLoop** slot) {
+        EventLoop loop{1024, m_backend};
+        EventLoop::ChannelHandle listenCh = EventLoop::kInvalidChannel;
+        // 预留的空闲fd：fd用尽时腾出一个位置把连接接受下来再关掉，否则水平触发的listenfd一直可读，loop空转
+        int spareFd = listenFd >= 0 ? open("/dev/null", O_RDONLY | O_CLOEXEC) : -1;
+        if (listenFd >= 0 && loop.GetPoller().Uring()) {
+            // io_uring后端用multishot accept，一次提交持续产出新连接
+            listenCh = loop.AddCompletionFd(listenFd, [this, &loop, listenFd, &listenCh, &spareFd](const UringCompletion& c) {
+                if (c.result >= 0) Dispatch_(loop, c.result);
+                if (c.more) return;
+                // fd用尽且backlog已空时重新提交的accept会立即失败，同样要等一会儿
+                if ((c.result == -EMFILE || c.result == -ENFILE) && !DropPending_(listenFd, spareFd)) {
+                    loop.RunAfter(kAcceptBackoffMs, [&loop, listenFd, &listenCh] {
+                        loop.GetPoller().Uring()->PrepAccept(listenFd, listenCh);
+                    });
+                    return;
+                }
+                loop.GetPoller().Uring()->PrepAccept(listenFd, listenCh);
+            });
+            loop.GetPoller().Uring()->PrepAccept(listenFd, listenCh);
+        } else if (listenFd >= 0) {
+            listenCh = loop.AddFd(listenFd, EPOLLIN, [this, &loop, listenFd, &listenCh, &spareFd](uint32_t) {
+                HandleAccept_(loop, listenFd, listenCh, spareFd);
+            });
+        }
+        {
+            std::lock_guard lock{m_mutex};
+            *slot = &loop;
+            ++m_running;
+        }
+        m_cond.notify_one();
+        loop.Loop();
+        loop.DelFd(listenCh);
+        if (spareFd >= 0) close(spareFd);
+    }
+
+    // 水平触发，一次把backlog取空
+    void HandleAccept_(EventLoop& loop, int listenFd, EventLoop::ChannelHandle listenCh, int& spareFd) {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd >= 0) {
+                Dispatch_(loop, fd);
+                continue;
+            }
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno == EMFILE || errno == ENFILE) {
+                if (DropPending_(listenFd, spareFd)) continue;
+                // fd用尽时backlog为空accept4也返回EMFILE，这时等下次可读即可；
+                // 预留fd也拿不回来时暂停监听一会儿再试
+                if (errno != EAGAIN) {
+                    loop.ModFd(listenCh, 0);
+                    loop.RunAfter(kAcceptBackoffMs, [&loop, listenCh] { loop.ModFd(listenCh, EPOLLIN); });
+                }
+            }
+            break;
+        }
+    }
+
+    // 用预留的fd接受一个连接并立即关闭，对端看到连接被关闭而不是一直挂在backlog里；
+    // 返回false时errno为EAGAIN(backlog已空)或EMFILE/ENFILE(没有预留fd可用)
+    static bool DropPending_(int listenFd, int& spareFd) {
+        if (spareFd >= 0) close(spareFd);
+        int fd = accept(listenFd, nullptr, nullptr);
+        int saved = errno;
+        if (fd >= 0) close(fd);
+        spareFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        errno = saved;
+        return fd >= 0;
+    }
+
+    void Dispatch_(EventLoop& loop, int fd) {
+        if (m_mode == DispatchMode::ReusePort) {
+            OnConnection_(loop, fd);
+        } else {
+            EventLoop* sub = m_loops[m_next++ % m_loops.size()];
+            sub->QueueInLoop([this, sub, fd] { OnConnection_(*sub, fd); });
+        }
+    }
+
+    // 停止过程中loop退出前才执行到的连接直接关掉
+    void OnConnection_(EventLoop& loop, int fd) {
+        if (m_connCb && !m_stopping.load(std::memory_order_acquire)) m_connCb(loop, fd);
+        else close(fd);
+    }
+
+    void CloseListenFds_() {
+        for (int fd : m_listenFds) close(fd);
+        m_listenFds.clear();
+    }
+
+    static constexpr int kAcceptBackoffMs = 100;
+
+    uint16_t m_port;
+    std::size_t m_threadCount;
+    DispatchMode m_mode;
+    PollerBackend m_backend;
+    ConnectionCallback m_connCb;
+    bool m_started = false;
+
+    std::vector<int> m_listenFds;
+    std::vector<std::thread> m_threads;
+    std::vector<EventLoop*> m_loops;  // 子reactor
+    EventLoop* m_acceptor = nullptr;  // 仅RoundRobin模式
+    std::size_t m_next = 0;           // 只在acceptor线程访问
+    std::atomic<bool> m_stopping{false};
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::size_t m_running = 0;
+};
+
+#endif //MULTI_REACTOR_H
@@ -0,0 +1,68 @@
+#ifndef POLLER_H
+#define POLLER_H
+
+#include <memory>
+
+#include "epoller.h"
+#include "uring_poller.h"
+
+enum class PollerBackend {
+    Epoll,
+    IoUring     // 内核不支持时自动退回Epoll
+};
+
+// 启动时选定后端，接口与Epoller一致
+class Poller {
+public:
+    explicit Poller(PollerBackend backend = PollerBackend::Epoll, int maxEvent = 1024) {
+        if (backend == PollerBackend::IoUring && UringPoller::Supported()) {
+            auto uring = std::make_unique<UringPoller>(maxEvent);
+            if (uring->Valid()) m_uring = std::move(uring);
+        }
+        if (!m_uring) m_epoller = std::make_unique<Epoller>(maxEvent);
+    }
+
+    PollerBackend Backend() const noexcept { return m_uring ? PollerBackend::IoUring : PollerBackend::Epoll; }
+
+    // 仅io_uring后端有效，用于accept/recv/send等异步操作
+    UringPoller* Uring() noexcept { return m_uring.get(); }
+
+    bool AddFd(int fd, uint32_t events, uint64_t data) {
+        return m_uring ? m_uring->AddFd(fd, events, data) : m_epoller->AddFd(fd, events, data);
+    }
+
+    bool ModFd(int fd, uint32_t events, uint64_t data) {
+        return m_uring ? m_uring->ModFd(fd, events, data) : m_epoller->ModFd(fd, events, data);
+    }
+
+    bool DelFd(int fd) {
+        return m_uring ? m_uring->DelFd(fd) : m_epoller->DelFd(fd);
+    }
+
+    int Wait(int timeoutMs = -1) {
+        return m_uring ? m_uring->Wait(timeoutMs) : m_epoller->Wait(timeoutMs);
+    }
+
+    int GetEventFd(size_t i) const {
+        return m_uring ? m_uring->GetEventFd(i) : m_epoller->GetEventFd(i);
+    }
+
+    uint64_t GetEventData(size_t i) const {
+        return m_uring ? m_uring->GetEventData(i) : m_epoller->GetEventData(i);
+    }
+
+    uint32_t GetEvents(size_t i) const {
+        return m_uring ? m_uring->GetEvents(i) : m_epoller->GetEvents(i);
+    }
+
+    // 就绪通知之外的完成事件(accept/recv/send)，epoll后端恒为false
+    bool IsCompletion(size_t i) const {
+        return m_uring && m_uring->GetEventOp(i) != UringOp::Poll;
+    }
+
+private:
+    std::unique_ptr<Epoller> m_epoller;
+    std::unique_ptr<UringPoller> m_uring;
+};
+
+#endif //POLLER_H
@@ -0,0 +1,63 @@
+/*
+ * 线程池提交竞争的基准：N个外部线程同时add_task，比较ThreadPool(单锁队列)和WorkStealingPool
+ * 每个任务只做一次原子加，耗时基本都在提交和调度上；计时从放开提交线程到最后一个任务执行完
+ * 用法：pool_bench [每轮任务总数=1000000] [worker数=hardware_concurrency]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "thread_pool.h"
+#include "work_stealing_pool.h"
+
+template <typename Pool>
+double run(Pool& pool, std::size_t submitters, std::size_t total)
+{
+    std::size_t per = total / submitters;
+    total = per * submitters;
+    std::atomic<std::size_t> done{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < submitters; ++i) {
+        threads.emplace_back([&] {
+            while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+            for (std::size_t k = 0; k < per; ++k) {
+                pool.add_task([&done, total] {
+                    if (done.fetch_add(1, std::memory_order_acq_rel) + 1 == total) done.notify_one();
+                });
+            }
+        });
+    }
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& t : threads) t.join();
+    for (std::size_t n = done.load(std::memory_order_acquire); n != total; n = done.load(std::memory_order_acquire)) {
+        done.wait(n, std::memory_order_acquire);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return total / elapsed.count();
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t total = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    std::size_t workers = argc > 2 ? strtoull(argv[2], nullptr, 10) : std::thread::hardware_concurrency();
+    if (workers == 0) workers = 1;
+
+    printf("%zu workers, %zu tasks per run, Mtasks/s\n", workers, total);
+    printf("%10s %12s %16s %8s\n", "submitters", "ThreadPool", "WorkStealingPool", "ratio");
+    ThreadPool locked{workers};
+    WorkStealingPool stealing{workers};
+    for (std::size_t submitters : {1, 2, 4, 8, 16, 32, 64}) {
+        // 先各跑一轮预热(线程栈、分配器缓存)
+        run(locked, submitters, total / 10);
+        run(stealing, submitters, total / 10);
+        double a = run(locked, submitters, total);
+        double b = run(stealing, submitters, total);
+        printf("%10zu %12.2f %16.2f %7.2fx\n", submitters, a / 1e6, b / 1e6, b / a);
+    }
+    return 0;
+}
@@ -0,0 +1,204 @@
+/*
+ * PubSubHub的广播基准：N个WebSocket订阅者在同一个房间，主线程连续publish，
+ * 计时从第一条publish到所有订阅者都收齐全部消息
+ * 客户端是fork出来的子进程，每个最多kPerProcess个连接，用epoll读空；
+ * 每个子进程从不同的127.0.0.x连接，订阅者超过一个源地址的临时端口数(约28000)时也能连上
+ * 服务端每个订阅者占一个fd：启动时把RLIMIT_NOFILE的软限制提到硬限制，
+ * 硬限制不够(订阅者数+几十)时直接报错。10万订阅者要先提高硬限制，比如root下 ulimit -Hn 200000，
+ * 或在systemd里设LimitNOFILE；子进程每个只需要kPerProcess+几个fd
+ * 用法：pubsub_bench [订阅者数=10000] [消息数=1000] [载荷字节数=64] [loop数=1]
+ */
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "multi_reactor.h"
+#include "pubsub_hub.h"
+
+constexpr uint16_t kPort = 18200;
+constexpr int kPerProcess = 5000;
+constexpr std::size_t kHandshakeResponse = 129;   // 固定key、不协商扩展时101响应的长度
+
+const char kUpgrade[] =
+    "GET /room HTTP/1.1\r\nHost: bench\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+
+bool read_exact(int fd, void* buf, std::size_t n)
+{
+    auto p = static_cast<char*>(buf);
+    while (n > 0) {
+        ssize_t r = read(fd, p, n);
+        if (r <= 0) return false;
+        p += r;
+        n -= static_cast<std::size_t>(r);
+    }
+    return true;
+}
+
+// 子进程：建立count个连接并完成握手后报告，等到开始信号后读到每个连接expect字节，再报告收到的总字节数
+[[noreturn]] void client(int index, int count, std::size_t expect, int reportFd, int goFd)
+{
+    int ep = epoll_create1(0);
+    std::vector<int> fds;
+    for (int i = 0; i < count; ++i) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &one, sizeof(one));
+        sockaddr_in src{};
+        src.sin_family = AF_INET;
+        src.sin_addr.s_addr = htonl(INADDR_LOOPBACK + 1 + index % 250);
+        sockaddr_in dst{};
+        dst.sin_family = AF_INET;
+        dst.sin_port = htons(kPort);
+        dst.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&src), sizeof(src)) < 0 ||
+            connect(fd, reinterpret_cast<sockaddr*>(&dst), sizeof(dst)) < 0) {
+            perror("client connect");
+            _exit(1);
+        }
+        if (write(fd, kUpgrade, sizeof(kUpgrade) - 1) != static_cast<ssize_t>(sizeof(kUpgrade) - 1)) _exit(1);
+        fds.push_back(fd);
+    }
+    for (int fd : fds) {
+        char response[kHandshakeResponse];
+        if (!read_exact(fd, response, sizeof(response))) _exit(2);
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+    }
+    char c = 'r';
+    if (write(reportFd, &c, 1) != 1 || !read_exact(goFd, &c, 1)) _exit(3);
+
+    std::size_t total = 0;
+    std::size_t want = expect * static_cast<std::size_t>(count);
+    std::vector<epoll_event> events(256);
+    static char buf[64 * 1024];
+    while (total < want) {
+        int n = epoll_wait(ep, events.data(), static_cast<int>(events.size()), 10000);
+        if (n <= 0) break;
+        for (int i = 0; i < n; ++i) {
+            ssize_t r;
+            while ((r = read(events[i].data.fd, buf, sizeof(buf))) > 0) total += static_cast<std::size_t>(r);
+        }
+    }
+    if (write(reportFd, &total, sizeof(total)) != sizeof(total)) _exit(4);
+    _exit(0);
+}
+
+bool raise_fd_limit(std::size_t need)
+{
+    rlimit rl{};
+    if (getrlimit(RLIMIT_NOFILE, &rl) < 0) return false;
+    if (rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    if (rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur < need) {
+        fprintf(stderr, "RLIMIT_NOFILE is %llu, need at least %zu: raise the hard limit first (ulimit -Hn)\n",
+                static_cast<unsigned long long>(rl.rlim_cur), need);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    int subscribers = argc > 1 ? atoi(argv[1]) : 10000;
+    int messages = argc > 2 ? atoi(argv[2]) : 1000;
+    std::size_t size = argc > 3 ? strtoull(argv[3], nullptr, 10) : 64;
+    std::size_t loopCount = argc > 4 ? strtoull(argv[4], nullptr, 10) : 1;
+    if (subscribers <= 0 || messages <= 0 || size > 65535 || loopCount == 0) {
+        fprintf(stderr, "usage: %s [subscribers] [messages] [payload bytes <= 65535] [loops]\n", argv[0]);
+        return 1;
+    }
+    // 每个订阅者一个socket，另外是监听fd、eventfd、epoll/io_uring和管道
+    if (!raise_fd_limit(static_cast<std::size_t>(subscribers) + 64 + 8 * loopCount)) return 1;
+    signal(SIGPIPE, SIG_IGN);
+
+    std::size_t frame = size + (size > 125 ? 4 : 2);
+    std::size_t expect = frame * static_cast<std::size_t>(messages);
+    int processes = (subscribers + kPerProcess - 1) / kPerProcess;
+    int report[2], go[2];
+    if (pipe(report) < 0 || pipe(go) < 0) return 1;
+
+    MultiReactor reactor{kPort, loopCount};
+    PubSubHub* hub = nullptr;
+    std::atomic<int> subscribed{0};
+    HttpConnOptions options;
+    options.onMessage = [](HttpConn&, const WebSocketMessage&) {};
+    options.onOpen = [&](HttpConn& conn) {
+        hub->subscribe(conn, "room");
+        subscribed.fetch_add(1, std::memory_order_relaxed);
+    };
+    options.onClose = [&](HttpConn& conn) { hub->unsubscribeAll(conn); };
+    reactor.SetConnectionCallback([&](EventLoop& loop, int fd) { HttpConn::open(loop, fd, options); });
+    if (!reactor.Start()) {
+        fprintf(stderr, "failed to listen on %u\n", kPort);
+        return 1;
+    }
+    std::vector<EventLoop*> loops;
+    for (std::size_t i = 0; i < loopCount; ++i) loops.push_back(reactor.GetLoop(i));
+    // 不压缩，积压上限放大到不会丢消息，测的是编码一次、分发到所有订阅者的开销
+    PubSubOptions pubsubOptions;
+    pubsubOptions.compressThreshold = 0;
+    pubsubOptions.maxPendingBytes = std::max<std::size_t>(expect + 1024, 1024 * 1024);
+    PubSubHub pubsub{loops, pubsubOptions};
+    hub = &pubsub;
+
+    for (int p = 0; p < processes; ++p) {
+        int count = std::min(kPerProcess, subscribers - p * kPerProcess);
+        if (fork() == 0) client(p, count, expect, report[1], go[0]);
+    }
+    for (int p = 0; p < processes; ++p) {
+        char c;
+        if (!read_exact(report[0], &c, 1)) {
+            fprintf(stderr, "client process failed to connect\n");
+            reactor.Stop();
+            return 1;
+        }
+    }
+    while (subscribed.load(std::memory_order_relaxed) < subscribers) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    std::vector<std::uint8_t> payload(size, 'p');
+    std::vector<char> start(static_cast<std::size_t>(processes), 'g');
+    if (write(go[1], start.data(), start.size()) != static_cast<ssize_t>(start.size())) {
+        reactor.Stop();
+        return 1;
+    }
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < messages; ++i) {
+        // shard队列满时等loop线程取走
+        while (!pubsub.publish("room", WebSocketOpcode::Binary, payload)) std::this_thread::yield();
+    }
+    std::size_t received = 0;
+    for (int p = 0; p < processes; ++p) {
+        std::size_t got = 0;
+        read_exact(report[0], &got, sizeof(got));
+        received += got;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    while (wait(nullptr) > 0) {}
+
+    std::size_t want = expect * static_cast<std::size_t>(subscribers);
+    PubSubStats stats = pubsub.stats();
+    printf("%d subscribers, %zu loops, %d messages of %zu bytes\n", subscribers, loopCount, messages, size);
+    printf("%.3f s, %.0f msgs/s, %.2f M deliveries/s, received %zu/%zu bytes, dropped %llu\n",
+           elapsed.count(), messages / elapsed.count(), static_cast<double>(subscribers) * messages / elapsed.count() / 1e6,
+           received, want, static_cast<unsigned long long>(stats.dropped));
+    reactor.Stop();
+    return received == want ? 0 : 1;
+}
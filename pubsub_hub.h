@@ -0,0 +1,404 @@
+#pragma once
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "event_loop.h"
+#include "http_conn.h"
+#include "mpmc_queue.h"
+#include "websocket_deflate.h"
+#include "websocket_writer.h"
+
+// 订阅者的发送队列积压超过maxPendingBytes时的处理
+enum class SlowConsumerPolicy : std::uint8_t {
+	Drop,			// 丢掉发给它的新消息
+	Coalesce,		// 每个房间只保留最新一条，积压写完后补发
+	Disconnect		// 立即断开
+};
+
+struct PubSubOptions {
+	std::size_t maxPendingBytes = 1024 * 1024;
+	SlowConsumerPolicy policy = SlowConsumerPolicy::Drop;
+	// 消息不短于这个值时额外做一次无上下文压缩，发给协商了server_no_context_takeover的订阅者；0表示不压缩
+	std::size_t compressThreshold = 256;
+};
+
+struct PubSubStats {
+	std::uint64_t published = 0;
+	std::uint64_t delivered = 0;		// 写入订阅者发送队列(或直接写出)的消息数
+	std::uint64_t dropped = 0;
+	std::uint64_t coalesced = 0;		// 慢消费者被新消息覆盖、最终没有发出的消息数
+	std::uint64_t disconnected = 0;
+	std::uint64_t overflowed = 0;		// shard队列满，整个shard没收到的消息数
+};
+
+namespace pubsub {
+
+inline constexpr std::size_t kShardQueueSize = 4096;
+inline constexpr std::size_t kDrainBatch = 64;
+
+// 一次发布的内容，所有shard共享同一份，最后一个shard处理完时释放
+struct Message {
+	std::string topic;
+	EncodedFrameRef frame;
+	EncodedFrameRef deflated;		// 无上下文压缩的帧，不值得压缩时为空
+};
+
+using MessagePtr = std::shared_ptr<const Message>;
+
+} // namespace pubsub
+
+/*
+ * 按reactor线程分片的发布/订阅：每个loop一个shard，保存本线程连接的订阅关系，只在本线程访问
+ * publish可以在任意线程调用：帧只编码(和压缩)一次，同一个引用计数的消息投递到各shard的无锁队列，
+ * 各shard在自己的loop里写给本地订阅者；队列从空变为非空时才用eventfd唤醒一次
+ * 一次取出多条消息时，先全部放进各订阅者的发送队列，再对每个订阅者写一次，系统调用数与消息数无关
+ * subscribe/unsubscribe在连接所属loop的线程里调用；连接关闭时(onClose里)必须调用unsubscribeAll
+ * 要用Coalesce策略时，把HttpConnOptions::onDrain转给onDrain
+ * hub要在所有loop开始运行之后创建，在所有loop停止之后析构
+ */
+class PubSubHub {
+public:
+	explicit PubSubHub(const std::vector<EventLoop*>& loops, PubSubOptions options = {})
+		: m_options{options} {
+		for (EventLoop* loop : loops) {
+			m_shards.push_back(std::make_unique<Shard>(*loop));
+		}
+		for (auto& shard : m_shards) {
+			Shard* s = shard.get();
+			s->loop.RunInLoop([this, s] {
+				s->channel = s->loop.AddFd(s->eventFd, EPOLLIN, [this, s](uint32_t) { drain(*s); });
+			});
+		}
+	}
+
+	PubSubHub(const PubSubHub&) = delete;
+	PubSubHub& operator=(const PubSubHub&) = delete;
+
+	// 返回false表示有shard的队列满了，那些shard的订阅者收不到这条消息
+	bool publish(std::string_view topic, WebSocketOpcode opcode, std::span<const std::uint8_t> payload) {
+		auto msg = std::make_shared<pubsub::Message>();
+		msg->topic = topic;
+		msg->frame = EncodedFrame::make(opcode, payload);
+		if (m_options.compressThreshold > 0) {
+			buildSharedDeflateFrame(opcode, payload, msg->deflated, 15, m_options.compressThreshold);
+		}
+		pubsub::MessagePtr shared = std::move(msg);
+		bool ok = true;
+		for (auto& shard : m_shards) {
+			if (shard->members.load(std::memory_order_relaxed) == 0) {
+				continue;
+			}
+			if (!shard->queue.push(shared)) {
+				shard->stats.overflowed.fetch_add(1, std::memory_order_relaxed);
+				ok = false;
+				continue;
+			}
+			// 与drain里的exchange配对：消费者清掉标记之后入队的消息一定会再唤醒一次
+			if (!shard->signaled.exchange(true, std::memory_order_acq_rel)) {
+				std::uint64_t one = 1;
+				ssize_t n = ::write(shard->eventFd, &one, sizeof(one));
+				(void)n;
+			}
+		}
+		m_published.fetch_add(1, std::memory_order_relaxed);
+		return ok;
+	}
+
+	// 重复订阅同一个房间无效
+	void subscribe(HttpConn& conn, std::string_view topic) {
+		Shard& shard = shardOf(conn);
+		auto& slot = shard.subscribers[&conn];
+		if (!slot) {
+			slot = std::make_unique<Subscriber>(conn);
+		}
+		Subscriber& sub = *slot;
+		auto [it, inserted] = shard.rooms.try_emplace(std::string(topic));
+		Room* room = &it->second;
+		if (inserted) {
+			room->name = it->first;
+		}
+		for (auto& membership : sub.rooms) {
+			if (membership.first == room) {
+				return;
+			}
+		}
+		sub.rooms.emplace_back(room, room->members.size());
+		room->members.emplace_back(&sub, sub.rooms.size() - 1);
+		shard.members.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// 不能在投递过程中(sendFrame的回调链里)调用，这种情况只能用unsubscribeAll
+	void unsubscribe(HttpConn& conn, std::string_view topic) {
+		Shard& shard = shardOf(conn);
+		assert(!shard.delivering);
+		auto it = shard.subscribers.find(&conn);
+		if (it == shard.subscribers.end()) {
+			return;
+		}
+		Subscriber& sub = *it->second;
+		for (std::size_t k = 0; k < sub.rooms.size(); ++k) {
+			if (sub.rooms[k].first->name == topic) {
+				leave(shard, sub, k);
+				break;
+			}
+		}
+		if (sub.rooms.empty()) {
+			shard.subscribers.erase(it);
+		}
+	}
+
+	void unsubscribeAll(HttpConn& conn) {
+		Shard& shard = shardOf(conn);
+		auto it = shard.subscribers.find(&conn);
+		if (it == shard.subscribers.end() || it->second->removed) {
+			return;
+		}
+		if (shard.delivering) {
+			// 正在遍历房间成员，投递完再移除
+			it->second->removed = true;
+			shard.removed.push_back(&conn);
+			return;
+		}
+		remove(shard, it);
+	}
+
+	// HttpConnOptions::onDrain：积压写完后补发合并掉的消息
+	void onDrain(HttpConn& conn) {
+		Shard& shard = shardOf(conn);
+		auto it = shard.subscribers.find(&conn);
+		if (it != shard.subscribers.end() && !it->second->pending.empty()) {
+			shard.delivering = true;
+			flushPending(shard, *it->second);
+			shard.delivering = false;
+			purge(shard);
+		}
+	}
+
+	// 各项计数的近似值，可以在任意线程调用
+	PubSubStats stats() const {
+		PubSubStats total;
+		total.published = m_published.load(std::memory_order_relaxed);
+		for (auto& shard : m_shards) {
+			total.delivered += shard->stats.delivered.load(std::memory_order_relaxed);
+			total.dropped += shard->stats.dropped.load(std::memory_order_relaxed);
+			total.coalesced += shard->stats.coalesced.load(std::memory_order_relaxed);
+			total.disconnected += shard->stats.disconnected.load(std::memory_order_relaxed);
+			total.overflowed += shard->stats.overflowed.load(std::memory_order_relaxed);
+		}
+		return total;
+	}
+
+private:
+	struct Room;
+
+	struct Subscriber {
+		explicit Subscriber(HttpConn& c) : conn{c} {}
+
+		HttpConn& conn;
+		std::vector<std::pair<Room*, std::size_t>> rooms;			// 房间和自己在房间成员里的下标
+		std::vector<std::pair<Room*, EncodedFrameRef>> pending;	// Coalesce：每个房间最新的一条
+		bool removed = false;
+		bool dirty = false;			// 本批有消息入队，等待flush
+	};
+
+	struct Room {
+		std::string_view name;										// 指向rooms里的key
+		std::vector<std::pair<Subscriber*, std::size_t>> members;	// 订阅者和本房间在它rooms里的下标
+	};
+
+	// 除overflowed(publish线程fetch_add)外只有shard自己的线程写，stats()从其他线程读
+	struct Counters {
+		std::atomic<std::uint64_t> delivered{0};
+		std::atomic<std::uint64_t> dropped{0};
+		std::atomic<std::uint64_t> coalesced{0};
+		std::atomic<std::uint64_t> disconnected{0};
+		std::atomic<std::uint64_t> overflowed{0};
+
+		void add(std::atomic<std::uint64_t>& counter) {
+			counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+	};
+
+	struct alignas(64) Shard {
+		explicit Shard(EventLoop& l) : loop{l}, eventFd{::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)} {
+			assert(eventFd >= 0);
+		}
+		~Shard() { ::close(eventFd); }
+
+		EventLoop& loop;
+		int eventFd;
+		EventLoop::ChannelHandle channel = EventLoop::kInvalidChannel;
+		mpmc_queue<pubsub::MessagePtr, pubsub::kShardQueueSize> queue;
+		alignas(64) std::atomic<bool> signaled{false};
+		std::atomic<std::size_t> members{0};		// 订阅关系总数，为0时publish跳过这个shard
+		Counters stats;
+
+		// 以下只在loop线程里访问
+		alignas(64) std::unordered_map<std::string, Room> rooms;
+		std::unordered_map<HttpConn*, std::unique_ptr<Subscriber>> subscribers;
+		std::vector<HttpConn*> removed;
+		std::vector<Subscriber*> dirty;
+		bool delivering = false;
+	};
+
+	Shard& shardOf(HttpConn& conn) {
+		for (auto& shard : m_shards) {
+			if (&shard->loop == &conn.loop()) {
+				assert(shard->loop.IsInLoopThread());
+				return *shard;
+			}
+		}
+		assert(false && "connection's loop is not part of this hub");
+		return *m_shards.front();
+	}
+
+	void drain(Shard& shard) {
+		std::uint64_t count;
+		ssize_t n = ::read(shard.eventFd, &count, sizeof(count));
+		(void)n;
+		shard.signaled.exchange(false, std::memory_order_acq_rel);
+		pubsub::MessagePtr batch[pubsub::kDrainBatch];
+		std::size_t got;
+		while ((got = shard.queue.try_pop_bulk(batch, pubsub::kDrainBatch)) > 0) {
+			shard.delivering = true;
+			for (std::size_t i = 0; i < got; ++i) {
+				deliver(shard, *batch[i], got > 1);
+				batch[i].reset();
+			}
+			for (Subscriber* sub : shard.dirty) {
+				sub->dirty = false;
+				if (!sub->removed) {
+					sub->conn.flush();
+				}
+			}
+			shard.dirty.clear();
+			shard.delivering = false;
+			purge(shard);
+		}
+	}
+
+	// batched时只入队，由drain统一写出；只有一条消息时直接写，一次写完就不碰引用计数
+	void deliver(Shard& shard, const pubsub::Message& msg, bool batched) {
+		auto it = shard.rooms.find(msg.topic);
+		if (it == shard.rooms.end()) {
+			return;
+		}
+		Room& room = it->second;
+		for (std::size_t i = 0; i < room.members.size(); ++i) {
+			Subscriber& sub = *room.members[i].first;
+			if (sub.removed) {
+				continue;
+			}
+			HttpConn& conn = sub.conn;
+			PerMessageDeflate* deflate = conn.deflate();
+			const EncodedFrameRef& frame = msg.deflated && deflate && deflate->canShare(15) ? msg.deflated : msg.frame;
+			if (conn.pendingBytes() > m_options.maxPendingBytes) {
+				slowConsumer(shard, sub, room, frame);
+				continue;
+			}
+			if (!sub.pending.empty()) {
+				flushPending(shard, sub);
+			}
+			if (batched) {
+				if (conn.queueFrame(frame)) {
+					shard.stats.add(shard.stats.delivered);
+					if (!sub.dirty) {
+						sub.dirty = true;
+						shard.dirty.push_back(&sub);
+					}
+				}
+			} else if (conn.sendFrame(frame)) {
+				shard.stats.add(shard.stats.delivered);
+			}
+		}
+	}
+
+	void slowConsumer(Shard& shard, Subscriber& sub, Room& room, const EncodedFrameRef& frame) {
+		switch (m_options.policy) {
+		case SlowConsumerPolicy::Drop:
+			shard.stats.add(shard.stats.dropped);
+			break;
+		case SlowConsumerPolicy::Coalesce:
+			for (auto& [r, f] : sub.pending) {
+				if (r == &room) {
+					f = frame;
+					shard.stats.add(shard.stats.coalesced);
+					return;
+				}
+			}
+			sub.pending.emplace_back(&room, frame);
+			break;
+		case SlowConsumerPolicy::Disconnect:
+			shard.stats.add(shard.stats.disconnected);
+			// onClose里的unsubscribeAll会推迟到本次投递结束
+			sub.conn.abort();
+			break;
+		}
+	}
+
+	void flushPending(Shard& shard, Subscriber& sub) {
+		std::vector<std::pair<Room*, EncodedFrameRef>> pending;
+		pending.swap(sub.pending);
+		for (auto& entry : pending) {
+			if (sub.removed || !sub.conn.sendFrame(entry.second)) {
+				break;
+			}
+			shard.stats.add(shard.stats.delivered);
+		}
+	}
+
+	void purge(Shard& shard) {
+		for (HttpConn* conn : shard.removed) {
+			auto it = shard.subscribers.find(conn);
+			if (it != shard.subscribers.end()) {
+				remove(shard, it);
+			}
+		}
+		shard.removed.clear();
+	}
+
+	void remove(Shard& shard, std::unordered_map<HttpConn*, std::unique_ptr<Subscriber>>::iterator it) {
+		Subscriber& sub = *it->second;
+		while (!sub.rooms.empty()) {
+			leave(shard, sub, sub.rooms.size() - 1);
+		}
+		shard.subscribers.erase(it);
+	}
+
+	// 把sub.rooms[k]这条订阅关系从两边移除：两边都把末尾元素挪到空出的位置，并修正对方记录的下标
+	void leave(Shard& shard, Subscriber& sub, std::size_t k) {
+		auto [room, i] = sub.rooms[k];
+		if (i + 1 != room->members.size()) {
+			room->members[i] = room->members.back();
+			auto [other, j] = room->members[i];
+			other->rooms[j].second = i;
+		}
+		room->members.pop_back();
+		if (k + 1 != sub.rooms.size()) {
+			sub.rooms[k] = sub.rooms.back();
+			auto [otherRoom, j] = sub.rooms[k];
+			otherRoom->members[j].second = k;
+		}
+		sub.rooms.pop_back();
+		std::erase_if(sub.pending, [room](const auto& entry) { return entry.first == room; });
+		shard.members.fetch_sub(1, std::memory_order_relaxed);
+		if (room->members.empty()) {
+			shard.rooms.erase(std::string(room->name));
+		}
+	}
+
+	PubSubOptions m_options;
+	std::vector<std::unique_ptr<Shard>> m_shards;
+	std::atomic<std::uint64_t> m_published{0};
+};
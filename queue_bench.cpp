@@ -0,0 +1,124 @@
+/*
+ * 有界队列的基准：1~64个生产者、固定数量的消费者，比较block_queue(互斥锁)和mpmc_queue
+ * mpmc_queue分别测逐个push/pop和try_push_bulk/try_pop_bulk(每次最多kBatch个)；队列满时生产者让出CPU重试
+ * 生产完后放入一个结束标记，消费者取到后放回去再退出；计时到最后一个消费者退出
+ * 用法：queue_bench [每轮元素总数=2000000] [消费者数=4]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "block_queue.h"
+#include "mpmc_queue.h"
+
+constexpr std::size_t kCapacity = 1024;
+constexpr std::size_t kBatch = 32;
+constexpr std::uint64_t kStop = ~std::uint64_t{0};
+
+using locked_queue = block_queue<std::uint64_t, kCapacity>;
+using lockfree_queue = mpmc_queue<std::uint64_t, kCapacity>;
+
+template <typename Q>
+void push_one(Q& q, std::uint64_t v)
+{
+    while (!q.push(v)) std::this_thread::yield();
+}
+
+// block_queue::pop(T&)和带默认超时参数的pop重载有歧义，带超时的版本在队列为空时会对同一把锁重复加锁
+bool pop_one(locked_queue& q, std::uint64_t& v)
+{
+    return (q.*static_cast<bool (locked_queue::*)(std::uint64_t&)>(&locked_queue::pop))(v);
+}
+
+bool pop_one(lockfree_queue& q, std::uint64_t& v)
+{
+    return q.pop(v);
+}
+
+template <typename Q, bool Bulk>
+double run(std::size_t producers, std::size_t consumers, std::size_t total)
+{
+    auto q = std::make_unique<Q>();
+    std::size_t per = total / producers;
+    std::atomic<bool> go{false};
+    std::atomic<std::uint64_t> sum{0};
+    std::vector<std::thread> consumer_threads;
+    for (std::size_t i = 0; i < consumers; ++i) {
+        consumer_threads.emplace_back([&] {
+            std::uint64_t local = 0;
+            std::uint64_t buf[kBatch];
+            while (true) {
+                std::size_t n = 0;
+                if constexpr (Bulk) n = q->try_pop_bulk(buf, kBatch);
+                if (n == 0) {
+                    pop_one(*q, buf[0]);
+                    n = 1;
+                }
+                bool stop = false;
+                for (std::size_t k = 0; k < n; ++k) {
+                    if (buf[k] == kStop) stop = true;
+                    else local += buf[k];
+                }
+                if (stop) {
+                    push_one(*q, kStop);
+                    break;
+                }
+            }
+            sum.fetch_add(local, std::memory_order_relaxed);
+        });
+    }
+    std::vector<std::thread> producer_threads;
+    for (std::size_t i = 0; i < producers; ++i) {
+        producer_threads.emplace_back([&] {
+            while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+            if constexpr (Bulk) {
+                std::uint64_t buf[kBatch];
+                for (std::size_t done = 0; done < per;) {
+                    std::size_t n = std::min(kBatch, per - done);
+                    for (std::size_t k = 0; k < n; ++k) buf[k] = 1;
+                    for (std::size_t pushed = 0; pushed < n;) {
+                        std::size_t m = q->try_push_bulk(buf + pushed, n - pushed);
+                        if (m == 0) std::this_thread::yield();
+                        pushed += m;
+                    }
+                    done += n;
+                }
+            } else {
+                for (std::size_t k = 0; k < per; ++k) push_one(*q, 1);
+            }
+        });
+    }
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& t : producer_threads) t.join();
+    push_one(*q, kStop);
+    for (auto& t : consumer_threads) t.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if (sum.load() != per * producers) {
+        fprintf(stderr, "lost items: %llu of %zu\n", static_cast<unsigned long long>(sum.load()), per * producers);
+        exit(1);
+    }
+    return per * producers / elapsed.count();
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t total = argc > 1 ? strtoull(argv[1], nullptr, 10) : 2000000;
+    std::size_t consumers = argc > 2 ? strtoull(argv[2], nullptr, 10) : 4;
+    if (consumers == 0) consumers = 1;
+
+    printf("%zu consumers, capacity %zu, %zu items per run, Mitems/s\n", consumers, kCapacity, total);
+    printf("%9s %12s %12s %12s\n", "producers", "block_queue", "mpmc", "mpmc bulk");
+    for (std::size_t producers : {1, 2, 4, 8, 16, 32, 64}) {
+        double a = run<locked_queue, false>(producers, consumers, total);
+        double b = run<lockfree_queue, false>(producers, consumers, total);
+        double c = run<lockfree_queue, true>(producers, consumers, total);
+        printf("%9zu %12.2f %12.2f %12.2f\n", producers, a / 1e6, b / 1e6, c / 1e6);
+    }
+    return 0;
+}
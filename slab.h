@@ -0,0 +1,116 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+#include <assert.h>
+
+/*
+ * 带代数(generation)的对象池，用于连接等频繁创建销毁的对象
+ * Handle = generation << 32 | index，可直接放进epoll_event.data.u64，
+ * 事件分发时按下标取对象；fd被复用后旧事件的generation对不上，Get返回nullptr
+ * 对象按块分配，地址在释放前保持不变
+ */
+template <typename T, std::size_t ChunkSize = 1024>
+class Slab {
+public:
+    using Handle = std::uint64_t;
+    static constexpr Handle kInvalidHandle = 0;   // generation从1开始，0永远无效
+
+    Slab() = default;
+    ~Slab() { clear(); }
+
+    Slab(const Slab&) = delete;
+    Slab& operator=(const Slab&) = delete;
+
+    template <typename... Args>
+    Handle emplace(Args&&... args) {
+        std::uint32_t index;
+        if (!m_freeList.empty()) {
+            index = m_freeList.back();
+            m_freeList.pop_back();
+        } else {
+            if (m_capacity % ChunkSize == 0) {
+                m_chunks.push_back(std::make_unique<Slot[]>(ChunkSize));
+            }
+            index = m_capacity++;
+        }
+        Slot& slot = slot_(index);
+        ::new (static_cast<void*>(slot.storage)) T(std::forward<Args>(args)...);
+        slot.alive = true;
+        ++m_size;
+        return static_cast<Handle>(slot.generation) << 32 | index;
+    }
+
+    // 失效或已释放的handle返回nullptr
+    T* get(Handle h) noexcept {
+        std::uint32_t index = static_cast<std::uint32_t>(h);
+        if (index >= m_capacity) return nullptr;
+        Slot& slot = slot_(index);
+        if (slot.generation != static_cast<std::uint32_t>(h >> 32) || !slot.alive) return nullptr;
+        return std::launder(reinterpret_cast<T*>(slot.storage));
+    }
+
+    // 立即使handle失效，对象在collect()之前保持可用，便于在对象自身的回调里释放
+    bool release(Handle h) noexcept {
+        if (get(h) == nullptr) return false;
+        std::uint32_t index = static_cast<std::uint32_t>(h);
+        Slot& slot = slot_(index);
+        slot.alive = false;
+        if (++slot.generation == 0) slot.generation = 1;
+        m_pending.push_back(index);
+        --m_size;
+        return true;
+    }
+
+    // 析构release过的对象并回收槽位
+    void collect() noexcept {
+        for (std::uint32_t index : m_pending) {
+            std::launder(reinterpret_cast<T*>(slot_(index).storage))->~T();
+            m_freeList.push_back(index);
+        }
+        m_pending.clear();
+    }
+
+    void erase(Handle h) noexcept {
+        if (release(h)) collect();
+    }
+
+    void clear() noexcept {
+        collect();
+        for (std::uint32_t i = 0; i < m_capacity; ++i) {
+            Slot& slot = slot_(i);
+            if (!slot.alive) continue;
+            std::launder(reinterpret_cast<T*>(slot.storage))->~T();
+            slot.alive = false;
+            if (++slot.generation == 0) slot.generation = 1;
+            m_freeList.push_back(i);
+        }
+        m_size = 0;
+    }
+
+    std::size_t size() const noexcept { return m_size; }
+    bool empty() const noexcept { return m_size == 0; }
+
+private:
+    struct Slot {
+        alignas(T) unsigned char storage[sizeof(T)];
+        std::uint32_t generation = 1;
+        bool alive = false;
+    };
+
+    Slot& slot_(std::uint32_t index) noexcept {
+        return m_chunks[index / ChunkSize][index % ChunkSize];
+    }
+
+    std::vector<std::unique_ptr<Slot[]>> m_chunks;
+    std::vector<std::uint32_t> m_freeList;
+    std::vector<std::uint32_t> m_pending;
+    std::uint32_t m_capacity = 0;
+    std::size_t m_size = 0;
+};
+
+#endif //SLAB_H
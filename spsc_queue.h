@@ -0,0 +1,177 @@
+/*
+ * 单生产者单消费者环形队列
+ * head/tail分处不同缓存行，双方各自缓存对方的下标，只有缓存显示满/空时才去读对方的原子变量
+ * 等待策略可选：busy_spin_wait(纯自旋，延迟最低)、spin_yield_wait(自旋后让出CPU)、
+ * futex_wait(自旋后在futex上休眠，对方只有在有人休眠时才发起唤醒)
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace detail {
+
+inline void cpu_relax() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+} // namespace detail
+
+// 等待策略：wait在ready()为真前不返回；notify在对方可能在等待时调用
+struct busy_spin_wait
+{
+    template <typename Ready>
+    static void wait(Ready&& ready, std::atomic<std::uint32_t>&, std::atomic<std::uint32_t>&) noexcept
+    {
+        while (!ready()) detail::cpu_relax();
+    }
+
+    static void notify(std::atomic<std::uint32_t>&, std::atomic<std::uint32_t>&) noexcept {}
+};
+
+struct spin_yield_wait
+{
+    static constexpr int kSpinCount = 128;
+
+    template <typename Ready>
+    static void wait(Ready&& ready, std::atomic<std::uint32_t>&, std::atomic<std::uint32_t>&) noexcept
+    {
+        for (int i = 0; !ready(); ++i) {
+            if (i < kSpinCount) detail::cpu_relax();
+            else std::this_thread::yield();
+        }
+    }
+
+    static void notify(std::atomic<std::uint32_t>&, std::atomic<std::uint32_t>&) noexcept {}
+};
+
+struct futex_wait
+{
+    static constexpr int kSpinCount = 128;
+
+    template <typename Ready>
+    static void wait(Ready&& ready, std::atomic<std::uint32_t>& epoch, std::atomic<std::uint32_t>& sleepers) noexcept
+    {
+        for (int i = 0; i < kSpinCount; ++i) {
+            if (ready()) return;
+            detail::cpu_relax();
+        }
+        while (true) {
+            std::uint32_t e = epoch.load(std::memory_order_acquire);
+            sleepers.fetch_add(1, std::memory_order_seq_cst);
+            if (ready()) {
+                sleepers.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+            epoch.wait(e, std::memory_order_acquire);
+            sleepers.fetch_sub(1, std::memory_order_relaxed);
+            if (ready()) return;
+        }
+    }
+
+    static void notify(std::atomic<std::uint32_t>& epoch, std::atomic<std::uint32_t>& sleepers) noexcept
+    {
+        // 与wait里的sleepers++配对
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) > 0) {
+            epoch.fetch_add(1, std::memory_order_release);
+            epoch.notify_all();
+        }
+    }
+};
+
+template <typename T, std::size_t N, typename Wait = spin_yield_wait>
+class spsc_queue
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "spsc_queue capacity must be a power of two");
+
+public:
+    spsc_queue() : m_data{new T[N]} {}
+
+    spsc_queue(const spsc_queue&) = delete;
+    spsc_queue& operator=(const spsc_queue&) = delete;
+
+    // 生产者调用
+    template <typename U>
+    bool try_push(U&& item)
+    {
+        std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cached_head >= N) {
+            m_cached_head = m_head.load(std::memory_order_acquire);
+            if (tail - m_cached_head >= N) return false;
+        }
+        m_data[tail & (N - 1)] = std::forward<U>(item);
+        m_tail.store(tail + 1, std::memory_order_release);
+        Wait::notify(m_epoch, m_sleepers);
+        return true;
+    }
+
+    // 生产者调用，队列满时按等待策略等待消费者
+    template <typename U>
+    void push(U&& item)
+    {
+        if (try_push(std::forward<U>(item))) return;
+        Wait::wait([this] { return !full(); }, m_epoch, m_sleepers);
+        try_push(std::forward<U>(item));
+    }
+
+    // 消费者调用
+    bool try_pop(T& item)
+    {
+        std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cached_tail) {
+            m_cached_tail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cached_tail) return false;
+        }
+        item = std::move(m_data[head & (N - 1)]);
+        m_head.store(head + 1, std::memory_order_release);
+        Wait::notify(m_epoch, m_sleepers);
+        return true;
+    }
+
+    // 消费者调用，队列空时按等待策略等待生产者
+    void pop(T& item)
+    {
+        if (try_pop(item)) return;
+        Wait::wait([this] { return !empty(); }, m_epoch, m_sleepers);
+        try_pop(item);
+    }
+
+    bool empty() const noexcept
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+    bool full() const noexcept
+    {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire) >= N;
+    }
+
+    std::size_t size() const noexcept
+    {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+    std::size_t max_size() const noexcept { return N; }
+
+private:
+    std::unique_ptr<T[]> m_data;
+
+    alignas(64) std::atomic<std::size_t> m_head{0};   // 消费者写
+    std::size_t m_cached_tail = 0;                     // 消费者私有
+
+    alignas(64) std::atomic<std::size_t> m_tail{0};   // 生产者写
+    std::size_t m_cached_head = 0;                     // 生产者私有
+
+    alignas(64) std::atomic<std::uint32_t> m_epoch{0};
+    std::atomic<std::uint32_t> m_sleepers{0};
+};
@@ -0,0 +1,447 @@
+#pragma once
+
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "event_loop.h"
+#include "http_conn.h"
+#include "http_parser.h"
+#include "websocket_writer.h"
+
+struct StaticFileOptions {
+	std::size_t cacheBytes = 64 * 1024 * 1024;		// 预读进内存的小文件总大小上限
+	std::size_t maxPreloadSize = 256 * 1024;		// 超过的文件只缓存打开的fd，用sendfile发送
+	std::size_t maxOpenFiles = 256;					// 缓存的大文件fd个数上限
+	std::string index = "index.html";
+	std::string cacheControl = "public, max-age=60";
+};
+
+namespace static_file {
+
+inline std::string_view contentType(std::string_view path) {
+	std::size_t dot = path.rfind('.');
+	std::size_t slash = path.rfind('/');
+	if (dot == std::string_view::npos || (slash != std::string_view::npos && dot < slash)) {
+		return "application/octet-stream";
+	}
+	std::string_view ext = path.substr(dot + 1);
+	static constexpr std::pair<std::string_view, std::string_view> kTypes[] = {
+		{"html", "text/html; charset=utf-8"},
+		{"htm", "text/html; charset=utf-8"},
+		{"css", "text/css; charset=utf-8"},
+		{"js", "text/javascript; charset=utf-8"},
+		{"mjs", "text/javascript; charset=utf-8"},
+		{"json", "application/json"},
+		{"txt", "text/plain; charset=utf-8"},
+		{"xml", "application/xml"},
+		{"svg", "image/svg+xml"},
+		{"png", "image/png"},
+		{"jpg", "image/jpeg"},
+		{"jpeg", "image/jpeg"},
+		{"gif", "image/gif"},
+		{"webp", "image/webp"},
+		{"ico", "image/x-icon"},
+		{"woff", "font/woff"},
+		{"woff2", "font/woff2"},
+		{"wasm", "application/wasm"},
+		{"pdf", "application/pdf"},
+		{"mp4", "video/mp4"},
+	};
+	for (auto& [e, type] : kTypes) {
+		if (http_parse::equalsIgnoreCase(ext, e)) {
+			return type;
+		}
+	}
+	return "application/octet-stream";
+}
+
+// 请求路径是否可以直接映射到root下的文件：以'/'开头，不含"."/".."段、中间的空段、'\\'和NUL
+// 拒绝"//a.txt"这样的空段，同一个文件只有一种写法，缓存key和监听的目录名都是规范的；结尾的'/'表示目录下的index
+inline bool isSafePath(std::string_view path) {
+	if (path.empty() || path.front() != '/') {
+		return false;
+	}
+	std::size_t pos = 1;
+	while (pos <= path.size()) {
+		std::size_t slash = path.find('/', pos);
+		std::string_view segment = path.substr(pos, slash == std::string_view::npos ? std::string_view::npos : slash - pos);
+		if ((segment.empty() && slash != std::string_view::npos) || segment == "." || segment == "..") {
+			return false;
+		}
+		if (slash == std::string_view::npos) {
+			break;
+		}
+		pos = slash + 1;
+	}
+	return path.find('\0') == std::string_view::npos && path.find('\\') == std::string_view::npos;
+}
+
+inline int hexValue(char c) {
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+// %XX解码，格式错误返回false
+inline bool percentDecode(std::string_view in, std::string& out) {
+	out.clear();
+	out.reserve(in.size());
+	for (std::size_t i = 0; i < in.size(); ++i) {
+		if (in[i] != '%') {
+			out += in[i];
+			continue;
+		}
+		if (i + 2 >= in.size()) {
+			return false;
+		}
+		int hi = hexValue(in[i + 1]);
+		int lo = hexValue(in[i + 2]);
+		if (hi < 0 || lo < 0) {
+			return false;
+		}
+		out += static_cast<char>(hi << 4 | lo);
+		i += 2;
+	}
+	return true;
+}
+
+inline std::string httpDate(std::time_t t) {
+	std::tm tm;
+	gmtime_r(&t, &tm);
+	char buf[32];
+	std::size_t n = std::strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+	return std::string(buf, n);
+}
+
+// If-None-Match是否命中：*或逗号分隔的列表里有etag(忽略弱校验前缀W/)
+inline bool etagMatches(std::string_view header, std::string_view etag) {
+	while (!header.empty()) {
+		std::size_t comma = header.find(',');
+		std::string_view item = header.substr(0, comma);
+		while (!item.empty() && item.front() == ' ') item.remove_prefix(1);
+		while (!item.empty() && item.back() == ' ') item.remove_suffix(1);
+		if (item.starts_with("W/")) {
+			item.remove_prefix(2);
+		}
+		if (item == "*" || item == etag) {
+			return true;
+		}
+		if (comma == std::string_view::npos) {
+			break;
+		}
+		header.remove_prefix(comma + 1);
+	}
+	return false;
+}
+
+struct StringHash {
+	using is_transparent = void;
+	std::size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+};
+
+} // namespace static_file
+
+/*
+ * 静态文件服务，每个EventLoop一个实例，只在所属线程使用，不加锁
+ * 小文件整个预读，和预先生成的200响应头(含ETag/Last-Modified)放在同一个EncodedFrame里，
+ * 命中时直接把这个引用计数的帧排进连接的发送队列，没有open/stat/read，也不拷贝
+ * 大文件缓存打开的fd和响应头，body用sendfile从页缓存直接发到socket，写不完时由HttpConn在EPOLLOUT时接着发
+ * 缓存按LRU淘汰，小文件按总字节数、大文件按fd个数限制
+ * 用inotify监视缓存过的文件所在的目录及其到root的各级上层目录，文件被修改、删除或改名，
+ * 上层目录被改名、删除或换成别的符号链接时移出缓存，下次请求重新加载
+ * 预读而不是mmap：文件被截断时mmap会SIGBUS，且预读的内容和响应头在一块内存里，一个iovec就能发出
+ */
+class StaticFileServer {
+public:
+	StaticFileServer(EventLoop& loop, std::string root, StaticFileOptions options = {})
+		: m_loop{loop}, m_root{std::move(root)}, m_options{std::move(options)} {
+		while (m_root.size() > 1 && m_root.back() == '/') {
+			m_root.pop_back();
+		}
+		m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (m_inotifyFd >= 0) {
+			m_inotifyChannel = m_loop.AddFd(m_inotifyFd, EPOLLIN, [this](uint32_t) { handleInotify(); });
+		}
+	}
+
+	~StaticFileServer() {
+		if (m_inotifyChannel != EventLoop::kInvalidChannel) {
+			m_loop.DelFd(m_inotifyChannel);
+		}
+		if (m_inotifyFd >= 0) {
+			::close(m_inotifyFd);
+		}
+	}
+
+	StaticFileServer(const StaticFileServer&) = delete;
+	StaticFileServer& operator=(const StaticFileServer&) = delete;
+
+	// 回复GET/HEAD请求，文件不存在时回复404；不是GET/HEAD时返回false，由调用方处理
+	bool serve(HttpConn& conn, const HttpRequest& req) {
+		bool head = req.method == "HEAD";
+		if (req.method != "GET" && !head) {
+			return false;
+		}
+		std::shared_ptr<const Entry> entry = find(req.path);
+		if (!entry) {
+			conn.sendResponse(404, "Not Found");
+			return true;
+		}
+		std::string_view ifNoneMatch = req.header("If-None-Match");
+		if (!ifNoneMatch.empty() && static_file::etagMatches(ifNoneMatch, entry->etag)) {
+			conn.sendHead(304, entry->size, {}, entry->validators);
+			return true;
+		}
+		if (head) {
+			conn.sendHead(200, entry->size, entry->contentType, entry->validators);
+		} else if (entry->response) {
+			if (conn.canSendPrepared()) {
+				conn.sendPrepared(entry->response);
+			} else {
+				// Connection头不同，只能重新生成响应头
+				std::span<const std::uint8_t> body = entry->response->bytes().subspan(entry->headerSize);
+				conn.sendResponse(200, {reinterpret_cast<const char*>(body.data()), body.size()},
+					entry->contentType, entry->validators);
+			}
+		} else {
+			conn.sendHead(200, entry->size, entry->contentType, entry->validators);
+			conn.sendFile(entry->file, 0, entry->size);
+		}
+		return true;
+	}
+
+	std::size_t cachedBytes() const { return m_cachedBytes; }
+	std::size_t cachedFiles() const { return m_entries.size(); }
+
+private:
+	struct Entry {
+		std::string key;					// 请求路径
+		std::string path;					// 文件系统路径
+		std::size_t size = 0;
+		std::string contentType;
+		std::string etag;
+		std::string validators;				// 预先生成的ETag/Last-Modified/Cache-Control头
+		EncodedFrameRef response;			// 小文件：keep-alive的200响应头 + 内容
+		std::size_t headerSize = 0;
+		std::shared_ptr<const SharedFile> file;	// 大文件：打开的fd
+	};
+	using Lru = std::list<std::shared_ptr<const Entry>>;
+
+	std::shared_ptr<const Entry> find(std::string_view requestPath) {
+		// 常见情况下请求路径本身就是key，查找不分配内存
+		std::string decoded;
+		std::string_view key = requestPath;
+		if (key.find('%') != std::string_view::npos) {
+			if (!static_file::percentDecode(requestPath, decoded)) {
+				return nullptr;
+			}
+			key = decoded;
+		}
+		if (!static_file::isSafePath(key)) {
+			return nullptr;
+		}
+		auto it = m_entries.find(key);
+		if (it != m_entries.end()) {
+			m_lru.splice(m_lru.begin(), m_lru, it->second);
+			return *it->second;
+		}
+		return load(std::string(key));
+	}
+
+	std::shared_ptr<const Entry> load(std::string key) {
+		std::string path = m_root + key;
+		if (path.back() == '/') {
+			path += m_options.index;
+		}
+		int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			return nullptr;
+		}
+		struct stat st;
+		if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+			::close(fd);
+			return nullptr;
+		}
+		// 先挂上监视再读内容，读完之前的修改也能收到通知
+		watchDirectory(path);
+
+		auto entry = std::make_shared<Entry>();
+		entry->key = std::move(key);
+		entry->contentType = static_file::contentType(path);
+		entry->path = std::move(path);
+		entry->size = static_cast<std::size_t>(st.st_size);
+		char etag[64];
+		int n = std::snprintf(etag, sizeof(etag), "\"%llx-%llx\"", static_cast<unsigned long long>(st.st_size),
+			static_cast<unsigned long long>(st.st_mtim.tv_sec) * 1000000000ull + static_cast<unsigned long long>(st.st_mtim.tv_nsec));
+		entry->etag.assign(etag, static_cast<std::size_t>(n));
+		entry->validators = "ETag: " + entry->etag + "\r\nLast-Modified: " + static_file::httpDate(st.st_mtim.tv_sec) + "\r\n";
+		if (!m_options.cacheControl.empty()) {
+			entry->validators += "Cache-Control: " + m_options.cacheControl + "\r\n";
+		}
+
+		if (entry->size <= m_options.maxPreloadSize) {
+			std::vector<std::uint8_t> body(entry->size);
+			std::size_t got = 0;
+			while (got < body.size()) {
+				ssize_t r = ::read(fd, body.data() + got, body.size() - got);
+				if (r < 0 && errno == EINTR) {
+					continue;
+				}
+				if (r <= 0) {
+					break;
+				}
+				got += static_cast<std::size_t>(r);
+			}
+			::close(fd);
+			// 读的过程中文件变短了：按读到的内容回复
+			body.resize(got);
+			entry->size = got;
+			std::string head = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(got) +
+				"\r\nContent-Type: " + entry->contentType + "\r\n" + entry->validators + "\r\n";
+			entry->headerSize = head.size();
+			entry->response = EncodedFrame::fromBytes(
+				{reinterpret_cast<const std::uint8_t*>(head.data()), head.size()}, body);
+			m_cachedBytes += entry->response->size();
+		} else {
+			entry->file = std::make_shared<const SharedFile>(fd);
+			++m_openFiles;
+		}
+
+		m_lru.push_front(entry);
+		m_entries.emplace(entry->key, m_lru.begin());
+		evict();
+		return entry;
+	}
+
+	// 淘汰最久未用的，直到预读字节数和打开的fd数都不超限；刚加载的不会被淘汰
+	void evict() {
+		while (m_lru.size() > 1 && (m_cachedBytes > m_options.cacheBytes || m_openFiles > m_options.maxOpenFiles)) {
+			erase(std::prev(m_lru.end()));
+		}
+	}
+
+	void erase(Lru::iterator it) {
+		const Entry& entry = **it;
+		if (entry.response) {
+			m_cachedBytes -= entry.response->size();
+		} else {
+			--m_openFiles;
+		}
+		m_entries.erase(entry.key);
+		m_lru.erase(it);
+	}
+
+	// 上层目录的改名/替换只在它的父目录里有事件，所以从文件所在目录一直监视到root
+	void watchDirectory(const std::string& path) {
+		if (m_inotifyFd < 0) {
+			return;
+		}
+		// path是root加上通过isSafePath的key，按'/'往上截就是各级上层目录
+		std::string dir = path.substr(0, path.rfind('/'));
+		while (true) {
+			addWatch(dir);
+			if (dir.size() <= m_root.size()) {
+				break;
+			}
+			dir.resize(dir.rfind('/'));
+		}
+	}
+
+	void addWatch(const std::string& dir) {
+		// 同一目录重复添加返回同一个wd；经符号链接从不同路径到达同一目录时wd也相同，每个路径都要记下
+		int wd = inotify_add_watch(m_inotifyFd, dir.c_str(),
+			IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CREATE | IN_DELETE_SELF | IN_MOVE_SELF);
+		if (wd < 0) {
+			return;
+		}
+		std::vector<std::string>& dirs = m_watches[wd];
+		if (std::find(dirs.begin(), dirs.end(), dir) == dirs.end()) {
+			dirs.push_back(dir);
+		}
+	}
+
+	void handleInotify() {
+		alignas(inotify_event) char buf[16 * 1024];
+		while (true) {
+			ssize_t n = ::read(m_inotifyFd, buf, sizeof(buf));
+			if (n <= 0) {
+				return;
+			}
+			for (char* p = buf; p < buf + n;) {
+				auto* ev = reinterpret_cast<inotify_event*>(p);
+				p += sizeof(inotify_event) + ev->len;
+				if (ev->mask & IN_Q_OVERFLOW) {
+					// 丢了事件，不知道哪些文件变了
+					m_lru.clear();
+					m_entries.clear();
+					m_cachedBytes = 0;
+					m_openFiles = 0;
+					continue;
+				}
+				auto watch = m_watches.find(ev->wd);
+				if (watch == m_watches.end()) {
+					continue;
+				}
+				if (ev->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+					for (const std::string& dir : watch->second) {
+						invalidate(dir, true);
+					}
+					if (ev->mask & IN_IGNORED) {
+						m_watches.erase(watch);
+					}
+					continue;
+				}
+				if (ev->len > 0) {
+					for (const std::string& dir : watch->second) {
+						// 文件名可能以NUL补齐；总是按前缀移出：被替换的符号链接没有IN_ISDIR，
+						// 但它下面的文件同样失效，对普通文件前缀匹配和精确匹配结果相同
+						invalidate(dir + '/' + ev->name, true);
+					}
+				}
+			}
+		}
+	}
+
+	// 移出path对应的文件；prefix为true时移出path目录下的所有文件
+	// 缓存里通常只有几百到几千个文件，变更也不频繁，直接遍历
+	void invalidate(const std::string& path, bool prefix) {
+		for (auto it = m_lru.begin(); it != m_lru.end();) {
+			const std::string& p = (*it)->path;
+			bool hit = p == path || (prefix && p.size() > path.size() && p.compare(0, path.size(), path) == 0 && p[path.size()] == '/');
+			auto next = std::next(it);
+			if (hit) {
+				erase(it);
+			}
+			it = next;
+		}
+	}
+
+	EventLoop& m_loop;
+	std::string m_root;
+	StaticFileOptions m_options;
+
+	Lru m_lru;									// 最近使用的在前
+	std::unordered_map<std::string, Lru::iterator, static_file::StringHash, std::equal_to<>> m_entries;
+	std::size_t m_cachedBytes = 0;
+	std::size_t m_openFiles = 0;
+
+	int m_inotifyFd = -1;
+	EventLoop::ChannelHandle m_inotifyChannel = EventLoop::kInvalidChannel;
+	std::unordered_map<int, std::vector<std::string>> m_watches;	// wd -> 目录(可能有多个别名)
+};
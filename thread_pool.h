@@ -1,13 +1,19 @@
 #pragma once
 #include <mutex>
 #include <condition_variable>
-#include <queue>
+#include <deque>
+#include <ranges>
 #include <thread>
-#include <functional>
+#include <type_traits>
 #include <assert.h>
 
+#include "inplace_task.h"
+
 class ThreadPool {
 public:
+    // 典型的连接处理lambda(几个指针/fd)都能放进64字节的内联缓冲区
+    using Task = inplace_task<64>;
+
     explicit ThreadPool(std::size_t thread_count = 8)
         : m_pool{std::make_shared<Pool>()}
     {
@@ -18,12 +24,16 @@ public:
                 while (true) {
                     if (!this_pool->tasks.empty()) {
                         auto task = std::move(this_pool->tasks.front());
-                        this_pool->tasks.pop();
+                        this_pool->tasks.pop_front();
                         lock.unlock();
                         task();
                         lock.lock();
                     } else if (this_pool->is_closed) break;
-                    else this_pool->cond.wait(lock);
+                    else {
+                        ++this_pool->idle;
+                        this_pool->cond.wait(lock);
+                        --this_pool->idle;
+                    }
                 }
             }}.detach();
         }
@@ -49,17 +59,38 @@ public:
     {
         {
             std::lock_guard lock{m_pool->mtx};
-            m_pool->tasks.emplace(std::forward<F>(task));
+            m_pool->tasks.emplace_back(std::forward<F>(task));
         }
         m_pool->cond.notify_one();
     }
 
+    // 批量提交：只加一次锁，按任务数和空闲线程数决定唤醒几个worker
+    // 传入右值range时任务被移入线程池
+    template <std::ranges::input_range R>
+    void add_tasks(R&& tasks)
+    {
+        std::size_t count = 0;
+        std::size_t idle = 0;
+        {
+            std::lock_guard lock{m_pool->mtx};
+            for (auto&& task : tasks) {
+                if constexpr (std::is_rvalue_reference_v<R&&>) m_pool->tasks.emplace_back(std::move(task));
+                else m_pool->tasks.emplace_back(task);
+                ++count;
+            }
+            idle = m_pool->idle;
+        }
+        if (count >= idle) m_pool->cond.notify_all();
+        else for (std::size_t i = 0; i < count; ++i) m_pool->cond.notify_one();
+    }
+
 private:
     struct Pool {
         std::mutex mtx;
         std::condition_variable cond;
-        bool is_closed;
-        std::queue<std::function<void()>> tasks;
+        bool is_closed = false;
+        std::size_t idle = 0;   // 正在cond上等待的worker数
+        std::deque<Task> tasks;
     };
 
     std::shared_ptr<Pool> m_pool;
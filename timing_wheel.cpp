@@ -0,0 +1,177 @@
+#include "timing_wheel.h"
+
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+TimingWheel::TimingWheel() noexcept : m_start{std::chrono::steady_clock::now()} {
+    m_buckets.fill(kNil);
+}
+
+void TimingWheel::UpdateClock() noexcept {
+    m_now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+TimingWheel::Entry& TimingWheel::entry_(int id) {
+    std::uint32_t i = index_(id);
+    if(i >= m_entries.size()) m_entries.resize(i + 1);
+    return m_entries[i];
+}
+
+// m_current为下一个待处理的时刻，比它早的到期时间都挂到m_current所在槽
+void TimingWheel::insert_(std::int32_t idx) noexcept {
+    Entry& e = m_entries[idx];
+    std::int64_t t = e.expires > m_current ? e.expires : m_current;
+    std::int64_t delta = t - m_current;
+    std::int32_t bucket;
+    if(delta < (1 << kLevel0Bits)) {
+        bucket = static_cast<std::int32_t>(t & (kLevel0Size - 1));
+        m_level0Bitmap[bucket >> 6] |= 1ull << (bucket & 63);
+    } else if(delta < (1 << (kLevel0Bits + kLevelBits))) {
+        bucket = kLevel0Size + ((t >> kLevel0Bits) & (kLevelSize - 1));
+    } else if(delta < (1 << (kLevel0Bits + 2 * kLevelBits))) {
+        bucket = kLevel0Size + kLevelSize + ((t >> (kLevel0Bits + kLevelBits)) & (kLevelSize - 1));
+    } else {
+        constexpr std::int64_t kMaxSpan = (1ll << (kLevel0Bits + 3 * kLevelBits)) - 1;
+        if(delta > kMaxSpan) t = m_current + kMaxSpan;
+        bucket = kLevel0Size + 2 * kLevelSize + ((t >> (kLevel0Bits + 2 * kLevelBits)) & (kLevelSize - 1));
+    }
+    e.scheduled = t;
+    e.bucket = bucket;
+    e.prev = kNil;
+    e.next = m_buckets[bucket];
+    if(e.next != kNil) m_entries[e.next].prev = idx;
+    m_buckets[bucket] = idx;
+}
+
+void TimingWheel::unlink_(std::int32_t idx) noexcept {
+    Entry& e = m_entries[idx];
+    if(e.bucket == kNil) return;
+    if(e.prev != kNil) m_entries[e.prev].next = e.next;
+    else m_buckets[e.bucket] = e.next;
+    if(e.next != kNil) m_entries[e.next].prev = e.prev;
+    if(e.bucket < static_cast<std::int32_t>(kLevel0Size) && m_buckets[e.bucket] == kNil) {
+        m_level0Bitmap[e.bucket >> 6] &= ~(1ull << (e.bucket & 63));
+    }
+    e.prev = e.next = e.bucket = kNil;
+}
+
+void TimingWheel::add(int id, int timeout, const TimeoutCallBack& cb) noexcept {
+    std::int32_t idx = static_cast<std::int32_t>(index_(id));
+    Entry& e = entry_(id);
+    e.expires = m_now + timeout;
+    e.cb = cb;
+    if(e.active && e.bucket != kNil && e.expires >= e.scheduled) return;
+    if(!e.active) {
+        e.active = true;
+        ++m_count;
+    }
+    unlink_(idx);
+    insert_(idx);
+}
+
+void TimingWheel::adjust(int id, int timeout) noexcept {
+    std::uint32_t i = index_(id);
+    if(i >= m_entries.size() || !m_entries[i].active) return;
+    Entry& e = m_entries[i];
+    e.expires = m_now + timeout;
+    // 推迟：只改时间，等原来的槽到期时再重新挂入
+    if(e.bucket != kNil && e.expires >= e.scheduled) return;
+    unlink_(static_cast<std::int32_t>(i));
+    insert_(static_cast<std::int32_t>(i));
+}
+
+void TimingWheel::doWork(int id) noexcept {
+    std::uint32_t i = index_(id);
+    if(i >= m_entries.size() || !m_entries[i].active) return;
+    Entry& e = m_entries[i];
+    unlink_(static_cast<std::int32_t>(i));
+    e.active = false;
+    --m_count;
+    TimeoutCallBack cb = std::move(e.cb);
+    if(cb) cb();
+}
+
+void TimingWheel::cascade_(int level) noexcept {
+    int shift = kLevel0Bits + (level - 1) * kLevelBits;
+    std::int32_t bucket = kLevel0Size + (level - 1) * kLevelSize + ((m_current >> shift) & (kLevelSize - 1));
+    std::int32_t idx = std::exchange(m_buckets[bucket], kNil);
+    while(idx != kNil) {
+        std::int32_t next = m_entries[idx].next;
+        m_entries[idx].bucket = kNil;
+        insert_(idx);
+        idx = next;
+    }
+}
+
+void TimingWheel::expire_(std::int64_t tick) noexcept {
+    std::int32_t bucket = static_cast<std::int32_t>(tick & (kLevel0Size - 1));
+    std::int32_t idx = std::exchange(m_buckets[bucket], kNil);
+    m_level0Bitmap[bucket >> 6] &= ~(1ull << (bucket & 63));
+
+    // 先把整个槽摘下来，回调里可能增删其他定时器
+    std::vector<std::int32_t> due;
+    while(idx != kNil) {
+        Entry& e = m_entries[idx];
+        std::int32_t next = e.next;
+        e.prev = e.next = e.bucket = kNil;
+        if(e.expires > tick) insert_(idx);
+        else due.push_back(idx);
+        idx = next;
+    }
+    for(std::int32_t i : due) {
+        Entry& e = m_entries[i];
+        if(!e.active || e.bucket != kNil) continue;   // 已在之前的回调里被执行或重新添加
+        e.active = false;
+        --m_count;
+        TimeoutCallBack cb = std::move(e.cb);
+        if(cb) cb();
+    }
+}
+
+void TimingWheel::tick() noexcept {
+    UpdateClock();
+    if(m_count == 0) {
+        m_current = m_now + 1;
+        return;
+    }
+    while(m_current <= m_now) {
+        if((m_current & (kLevel0Size - 1)) == 0) {
+            std::int64_t level1 = m_current >> kLevel0Bits;
+            if((level1 & (kLevelSize - 1)) == 0) {
+                if(((level1 >> kLevelBits) & (kLevelSize - 1)) == 0) cascade_(3);
+                cascade_(2);
+            }
+            cascade_(1);
+        }
+        expire_(m_current);
+        ++m_current;
+    }
+}
+
+void TimingWheel::clear() noexcept {
+    for(auto& e : m_entries) e = Entry{};
+    m_buckets.fill(kNil);
+    m_level0Bitmap.fill(0);
+    m_count = 0;
+}
+
+int TimingWheel::GetNextTick() noexcept {
+    tick();
+    if(m_count == 0) return -1;
+    // 第0层用位图找最近的非空槽；第0层为空时在下一次进位时醒来
+    std::int64_t target = (m_current + kLevel0Size - 1) & ~static_cast<std::int64_t>(kLevel0Size - 1);
+    std::uint32_t start = static_cast<std::uint32_t>(m_current & (kLevel0Size - 1));
+    for(std::uint32_t d = 0; d < kLevel0Size; ) {
+        std::uint32_t slot = (start + d) & (kLevel0Size - 1);
+        std::uint64_t word = m_level0Bitmap[slot >> 6] >> (slot & 63);
+        if(word != 0) {
+            std::uint32_t dist = d + std::countr_zero(word);
+            if(dist < kLevel0Size) target = std::min(target, m_current + dist);
+            break;
+        }
+        d += 64 - (slot & 63);
+    }
+    std::int64_t left = target - m_now;
+    return left > 0 ? static_cast<int>(left) : 0;
+}
@@ -0,0 +1,73 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+using TimeoutCallBack = std::function<void()>;
+
+/*
+ * 分层时间轮，接口与HeapTimer相同，用于大量空闲连接的超时管理
+ * 精度1ms，4层：256 + 64 + 64 + 64 个槽，覆盖约18.6小时，更远的到期时间先挂在最高层
+ * 节点按id(可为负)存放在数组中，用下标组成侵入式双向链表，添加/删除/重新调度都是O(1)
+ * adjust只把到期时间往后推时不移动节点，等所在槽到期时再按新的时间重新挂入(惰性调度)
+ */
+class TimingWheel {
+public:
+    TimingWheel() noexcept;
+    ~TimingWheel() noexcept { clear(); }
+
+    void adjust(int id, int newExpires) noexcept;
+    void add(int id, int timeOut, const TimeoutCallBack& cb) noexcept;
+    void doWork(int id) noexcept;
+    void clear() noexcept;
+    void tick() noexcept;
+    int GetNextTick() noexcept;
+
+    // 刷新缓存的当前时间，loop在Wait返回后调用一次；add/adjust使用缓存值
+    void UpdateClock() noexcept;
+    std::size_t size() const noexcept { return m_count; }
+
+private:
+    static constexpr int kLevel0Bits = 8;
+    static constexpr int kLevelBits = 6;
+    static constexpr int kLevels = 4;
+    static constexpr std::uint32_t kLevel0Size = 1u << kLevel0Bits;
+    static constexpr std::uint32_t kLevelSize = 1u << kLevelBits;
+    static constexpr std::int32_t kNil = -1;
+
+    struct Entry {
+        std::int64_t expires = 0;     // 实际到期时间(ms)
+        std::int64_t scheduled = 0;   // 当前所在槽对应的时间
+        TimeoutCallBack cb;
+        std::int32_t prev = kNil;
+        std::int32_t next = kNil;
+        std::int32_t bucket = kNil;
+        bool active = false;
+    };
+
+    static std::uint32_t index_(int id) noexcept {
+        return id >= 0 ? static_cast<std::uint32_t>(id) << 1 : (static_cast<std::uint32_t>(-(id + 1)) << 1) | 1;
+    }
+
+    Entry& entry_(int id);
+    void insert_(std::int32_t idx) noexcept;
+    void unlink_(std::int32_t idx) noexcept;
+    void cascade_(int level) noexcept;
+    void expire_(std::int64_t tick) noexcept;
+
+    std::chrono::steady_clock::time_point m_start;
+    std::int64_t m_now = 0;       // 缓存的当前时间(ms，相对m_start)
+    std::int64_t m_current = 0;   // 下一个待处理的时刻(ms)，之前的槽都已处理
+
+    std::vector<Entry> m_entries;
+    // 桶编号：第0层[0, 256)，之后每层64个
+    std::array<std::int32_t, kLevel0Size + (kLevels - 1) * kLevelSize> m_buckets;
+    std::array<std::uint64_t, kLevel0Size / 64> m_level0Bitmap{};
+    std::size_t m_count = 0;
+};
+
+#endif //TIMING_WHEEL_H
@@ -0,0 +1,486 @@
+#ifndef URING_POLLER_H
+#define URING_POLLER_H
+
+#include <linux/io_uring.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+#include <assert.h>
+
+// io_uring上完成的操作类型
+enum class UringOp : std::uint8_t {
+    Internal = 0,   // poll remove / cancel 等内部请求，不向上层报告
+    Poll,           // 就绪通知，与Epoller语义一致
+    Accept,         // multishot accept，result为新连接fd
+    Recv            // multishot recv，数据在provided buffer中
+};
+
+struct UringCompletion {
+    UringOp op;
+    int fd;
+    int result;                  // 字节数/新fd/-errno
+    bool more;                   // multishot请求是否仍然有效
+    std::span<std::uint8_t> buffer;  // recv到的数据，下一次Wait时buffer自动还给内核，需要的话先拷走
+    std::uint16_t bufferId;
+};
+
+/*
+ * 基于io_uring的事件后端，AddFd/ModFd/DelFd/Wait/GetEvent*与Epoller保持相同语义
+ * (就绪通知用multishot poll实现)；另外提供multishot accept和provided buffer ring上的multishot recv，
+ * 数据随完成事件一起到达，不再需要就绪通知之后的read：
+ * 所有SQE都在下一次Wait里随等待一起提交，一轮循环只需一次io_uring_enter
+ * 发送仍由调用方直接sendmsg(写不完时用ModFd等EPOLLOUT)：异步send要求缓冲区和msghdr活到完成事件返回，
+ * 连接关闭后也一样，而连接的发送队列随连接释放
+ */
+class UringPoller {
+public:
+    explicit UringPoller(int maxEvent = 1024, unsigned entries = 4096) : m_events(maxEvent) {
+        assert(!m_events.empty());
+        io_uring_params params{};
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = entries * 4;
+        m_ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (m_ringFd < 0) return;
+        if (!MapRings_(params)) {
+            close(m_ringFd);
+            m_ringFd = -1;
+        }
+    }
+
+    ~UringPoller() {
+        if (m_bufRing) {
+            io_uring_buf_reg reg{};
+            reg.bgid = kBufferGroup;
+            syscall(__NR_io_uring_register, m_ringFd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+            munmap(m_bufRing, m_bufRingSize);
+        }
+        delete[] m_bufBase;
+        if (m_sqes) munmap(m_sqes, m_sqesSize);
+        if (m_cqPtr && m_cqPtr != m_sqPtr) munmap(m_cqPtr, m_cqSize);
+        if (m_sqPtr) munmap(m_sqPtr, m_sqSize);
+        if (m_ringFd >= 0) close(m_ringFd);
+    }
+
+    UringPoller(const UringPoller&) = delete;
+    UringPoller& operator=(const UringPoller&) = delete;
+
+    bool Valid() const noexcept { return m_ringFd >= 0; }
+
+    // 内核需>=6.0(multishot recv、provided buffer ring、level poll)，且io_uring未被禁用
+    static bool Supported() noexcept {
+        io_uring_params params{};
+        params.flags = IORING_SETUP_SINGLE_ISSUER;   // 6.0引入，用来探测内核版本
+        int fd = static_cast<int>(syscall(__NR_io_uring_setup, 4, &params));
+        if (fd < 0) return false;
+        close(fd);
+        return (params.features & IORING_FEAT_EXT_ARG) && (params.features & IORING_FEAT_NODROP);
+    }
+
+    bool AddFd(int fd, uint32_t events) { return AddFd(fd, events, static_cast<uint64_t>(fd)); }
+
+    bool AddFd(int fd, uint32_t events, uint64_t data) {
+        if (fd < 0 || !Valid()) return false;
+        FdState& st = State_(fd);
+        if (st.polling || st.failed) return false;
+        st.data = data;
+        st.events = events;
+        st.polling = true;
+        ++st.seq;
+        return PrepPoll_(fd, st);
+    }
+
+    bool ModFd(int fd, uint32_t events) { return ModFd(fd, events, static_cast<uint64_t>(fd)); }
+
+    bool ModFd(int fd, uint32_t events, uint64_t data) {
+        if (fd < 0 || static_cast<size_t>(fd) >= m_fds.size()) return false;
+        FdState& st = m_fds[fd];
+        if (!st.polling && !st.failed && !(st.events & EPOLLONESHOT)) return false;
+        if (st.polling) RemovePoll_(fd, st);
+        st.data = data;
+        st.events = events;
+        st.polling = true;
+        st.failed = false;
+        ++st.seq;
+        return PrepPoll_(fd, st);
+    }
+
+    // 同时取消该fd上的accept/recv请求，之后迟到的完成事件按seq过滤掉
+    // 按user_data取消而不是按fd：调用方可能已经close(fd)，提交前fd号就可能被新连接复用
+    bool DelFd(int fd) {
+        if (fd < 0 || static_cast<size_t>(fd) >= m_fds.size()) return false;
+        FdState& st = m_fds[fd];
+        if (st.polling) RemovePoll_(fd, st);
+        bool ok = true;
+        if (st.accepting) ok = Cancel_(UserData_(UringOp::Accept, st.ioSeq, fd), fd) && ok;
+        if (st.receiving) ok = Cancel_(UserData_(UringOp::Recv, st.ioSeq, fd), fd) && ok;
+        st.polling = false;
+        st.failed = false;
+        st.accepting = false;
+        st.receiving = false;
+        st.events = 0;
+        ++st.seq;
+        ++st.ioSeq;
+        return ok;
+    }
+
+    int Wait(int timeoutMs = -1) {
+        RecycleBuffers_();
+        unsigned toSubmit = FlushSq_();
+        bool ready = CqReady_() > 0;
+        if (toSubmit > 0 || !ready) {
+            unsigned flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+            unsigned minComplete = (ready || timeoutMs == 0) ? 0 : 1;
+            __kernel_timespec ts{};
+            io_uring_getevents_arg arg{};
+            if (timeoutMs >= 0) {
+                ts.tv_sec = timeoutMs / 1000;
+                ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000000;
+                arg.ts = reinterpret_cast<uint64_t>(&ts);
+            }
+            int ret = Enter_(toSubmit, minComplete, flags, &arg, sizeof(arg));
+            if (ret < 0 && errno != ETIME && errno != EINTR && CqReady_() == 0) return -1;
+        }
+        return Harvest_();
+    }
+
+    int GetEventFd(size_t i) const {
+        assert(i < m_events.size());
+        return m_events[i].fd;
+    }
+
+    uint64_t GetEventData(size_t i) const {
+        assert(i < m_events.size());
+        return m_events[i].data;
+    }
+
+    uint32_t GetEvents(size_t i) const {
+        assert(i < m_events.size());
+        return m_events[i].events;
+    }
+
+    UringOp GetEventOp(size_t i) const {
+        assert(i < m_events.size());
+        return m_events[i].op;
+    }
+
+    UringCompletion GetCompletion(size_t i) const {
+        assert(i < m_events.size());
+        const Event& ev = m_events[i];
+        UringCompletion c{ev.op, ev.fd, ev.result, (ev.flags & IORING_CQE_F_MORE) != 0, {}, 0};
+        if (ev.flags & IORING_CQE_F_BUFFER) {
+            c.bufferId = static_cast<std::uint16_t>(ev.flags >> IORING_CQE_BUFFER_SHIFT);
+            if (ev.result > 0) c.buffer = {m_bufBase + static_cast<size_t>(c.bufferId) * m_bufSize, static_cast<size_t>(ev.result)};
+        }
+        return c;
+    }
+
+    bool HasBufferRing() const noexcept { return m_bufRing != nullptr; }
+
+    // 注册provided buffer ring，count需为2的幂；multishot recv前调用一次
+    bool SetupBufferRing(unsigned count, unsigned size) {
+        if (!Valid() || m_bufRing || count == 0 || (count & (count - 1)) || count > 32768) return false;
+        m_bufRingSize = count * sizeof(io_uring_buf);
+        void* ring = mmap(nullptr, m_bufRingSize, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+        if (ring == MAP_FAILED) return false;
+
+        io_uring_buf_reg reg{};
+        reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+        reg.ring_entries = count;
+        reg.bgid = kBufferGroup;
+        if (syscall(__NR_io_uring_register, m_ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+            munmap(ring, m_bufRingSize);
+            return false;
+        }
+        m_bufRing = static_cast<io_uring_buf_ring*>(ring);
+        m_bufCount = count;
+        m_bufSize = size;
+        m_bufBase = new std::uint8_t[static_cast<size_t>(count) * size];
+        for (unsigned bid = 0; bid < count; ++bid) PutBuffer_(static_cast<std::uint16_t>(bid));
+        PublishBuffers_();
+        return true;
+    }
+
+    bool PrepAccept(int listenFd, uint64_t data) {
+        if (listenFd < 0 || !Valid()) return false;
+        FdState& st = State_(listenFd);
+        st.data = data;
+        io_uring_sqe* sqe = GetSqe_();
+        if (!sqe) return false;
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = listenFd;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+        sqe->user_data = UserData_(UringOp::Accept, st.ioSeq, listenFd);
+        st.accepting = true;
+        return true;
+    }
+
+    // 同一个fd上只能有一个recv；完成事件的more为false时请求已结束，需要时重新Prep
+    bool PrepRecv(int fd, uint64_t data) {
+        if (fd < 0 || !m_bufRing) return false;
+        FdState& st = State_(fd);
+        st.data = data;
+        io_uring_sqe* sqe = GetSqe_();
+        if (!sqe) return false;
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = fd;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = kBufferGroup;
+        sqe->user_data = UserData_(UringOp::Recv, st.ioSeq, fd);
+        st.receiving = true;
+        return true;
+    }
+
+    // 停止fd上的multishot recv(如读暂停时)，不丢数据：取消生效前收到的数据照常报告，
+    // 最后以more为false的完成事件(通常是-ECANCELED)结束
+    bool CancelRecv(int fd) {
+        if (fd < 0 || static_cast<size_t>(fd) >= m_fds.size() || !m_fds[fd].receiving) return false;
+        return Cancel_(UserData_(UringOp::Recv, m_fds[fd].ioSeq, fd), fd);
+    }
+
+private:
+    static constexpr std::uint16_t kBufferGroup = 0;
+
+    struct FdState {
+        uint64_t data = 0;
+        uint32_t events = 0;
+        uint32_t seq = 0;     // DelFd/ModFd后递增，用于丢弃旧poll请求的完成事件
+        uint32_t ioSeq = 0;   // accept/recv用，只在DelFd时递增，ModFd不影响进行中的recv
+        bool polling = false;
+        bool accepting = false;
+        bool receiving = false;
+        bool failed = false;  // poll请求出错，已报告EPOLLERR，不再重新挂上；ModFd可以重新开始
+    };
+
+    struct Event {
+        UringOp op;
+        int fd;
+        uint64_t data;
+        uint32_t events;
+        int result;
+        uint32_t flags;
+    };
+
+    // user_data: op(8) | seq(24) | fd(32)
+    static uint64_t UserData_(UringOp op, uint32_t seq, int fd) noexcept {
+        return static_cast<uint64_t>(op) << 56 | static_cast<uint64_t>(seq & 0xFFFFFF) << 32 | static_cast<uint32_t>(fd);
+    }
+
+    FdState& State_(int fd) {
+        if (static_cast<size_t>(fd) >= m_fds.size()) m_fds.resize(fd + 1);
+        return m_fds[fd];
+    }
+
+    bool MapRings_(const io_uring_params& p) {
+        m_sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        m_cqSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) m_sqSize = m_cqSize = std::max(m_sqSize, m_cqSize);
+
+        void* sq = mmap(nullptr, m_sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQ_RING);
+        if (sq == MAP_FAILED) return false;
+        m_sqPtr = sq;
+        void* cq = sq;
+        if (!single) {
+            cq = mmap(nullptr, m_cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_CQ_RING);
+            if (cq == MAP_FAILED) return false;
+        }
+        m_cqPtr = cq;
+
+        m_sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) return false;
+        m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+        auto* sqBase = static_cast<char*>(sq);
+        m_sqHead = reinterpret_cast<unsigned*>(sqBase + p.sq_off.head);
+        m_sqTail = reinterpret_cast<unsigned*>(sqBase + p.sq_off.tail);
+        m_sqMask = *reinterpret_cast<unsigned*>(sqBase + p.sq_off.ring_mask);
+        m_sqEntries = p.sq_entries;
+        m_sqArray = reinterpret_cast<unsigned*>(sqBase + p.sq_off.array);
+
+        auto* cqBase = static_cast<char*>(cq);
+        m_cqHead = reinterpret_cast<unsigned*>(cqBase + p.cq_off.head);
+        m_cqTail = reinterpret_cast<unsigned*>(cqBase + p.cq_off.tail);
+        m_cqMask = *reinterpret_cast<unsigned*>(cqBase + p.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe*>(cqBase + p.cq_off.cqes);
+        m_localTail = *m_sqTail;
+        return true;
+    }
+
+    int Enter_(unsigned toSubmit, unsigned minComplete, unsigned flags, void* arg, size_t argSize) {
+        return static_cast<int>(syscall(__NR_io_uring_enter, m_ringFd, toSubmit, minComplete, flags, arg, argSize));
+    }
+
+    io_uring_sqe* GetSqe_() {
+        unsigned head = std::atomic_ref<unsigned>{*m_sqHead}.load(std::memory_order_acquire);
+        if (m_localTail - head >= m_sqEntries) {
+            // SQ满了，先把已有的提交掉
+            unsigned toSubmit = FlushSq_();
+            if (Enter_(toSubmit, 0, 0, nullptr, 0) < 0) return nullptr;
+            head = std::atomic_ref<unsigned>{*m_sqHead}.load(std::memory_order_acquire);
+            if (m_localTail - head >= m_sqEntries) return nullptr;
+        }
+        unsigned index = m_localTail & m_sqMask;
+        io_uring_sqe* sqe = &m_sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        m_sqArray[index] = index;
+        ++m_localTail;
+        return sqe;
+    }
+
+    // 发布本地tail，返回待提交数量
+    unsigned FlushSq_() {
+        unsigned tail = *m_sqTail;
+        if (tail != m_localTail) std::atomic_ref<unsigned>{*m_sqTail}.store(m_localTail, std::memory_order_release);
+        unsigned head = std::atomic_ref<unsigned>{*m_sqHead}.load(std::memory_order_acquire);
+        return m_localTail - head;
+    }
+
+    unsigned CqReady_() const {
+        return std::atomic_ref<unsigned>{*m_cqTail}.load(std::memory_order_acquire) - *m_cqHead;
+    }
+
+    bool PrepPoll_(int fd, const FdState& st) {
+        io_uring_sqe* sqe = GetSqe_();
+        if (!sqe) return false;
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = fd;
+        sqe->poll32_events = st.events & 0xFFFF;
+        // 只有边沿触发用multishot；POLL_ADD不接受IORING_POLL_ADD_LEVEL，
+        // 水平触发改为每次触发后在Harvest_里重新挂一次单次poll，挂上时内核会立即检查当前状态
+        if ((st.events & EPOLLET) && !(st.events & EPOLLONESHOT)) sqe->len |= IORING_POLL_ADD_MULTI;
+        sqe->user_data = UserData_(UringOp::Poll, st.seq, fd);
+        return true;
+    }
+
+    bool Cancel_(uint64_t target, int fd) {
+        io_uring_sqe* sqe = GetSqe_();
+        if (!sqe) return false;
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = target;
+        sqe->user_data = UserData_(UringOp::Internal, 0, fd);
+        return true;
+    }
+
+    void RemovePoll_(int fd, const FdState& st) {
+        io_uring_sqe* sqe = GetSqe_();
+        if (!sqe) return;
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = UserData_(UringOp::Poll, st.seq, fd);
+        sqe->user_data = UserData_(UringOp::Internal, 0, fd);
+    }
+
+    // 上一批recv完成事件的buffer，连同没有交给回调的(channel已注销)一起还给内核
+    void RecycleBuffers_() {
+        for (size_t i = 0; i < m_eventCount; ++i) {
+            const Event& ev = m_events[i];
+            if (ev.flags & IORING_CQE_F_BUFFER) PutBuffer_(static_cast<std::uint16_t>(ev.flags >> IORING_CQE_BUFFER_SHIFT));
+        }
+        m_eventCount = 0;
+        PublishBuffers_();
+    }
+
+    int Harvest_() {
+        unsigned head = *m_cqHead;
+        unsigned tail = std::atomic_ref<unsigned>{*m_cqTail}.load(std::memory_order_acquire);
+        size_t n = 0;
+        while (head != tail && n < m_events.size()) {
+            const io_uring_cqe& cqe = m_cqes[head & m_cqMask];
+            ++head;
+            auto op = static_cast<UringOp>(cqe.user_data >> 56);
+            uint32_t seq = static_cast<uint32_t>(cqe.user_data >> 32) & 0xFFFFFF;
+            int fd = static_cast<int>(static_cast<uint32_t>(cqe.user_data));
+            if (op == UringOp::Internal) continue;
+
+            FdState& st = m_fds[fd];
+            if (((op == UringOp::Poll ? st.seq : st.ioSeq) & 0xFFFFFF) != seq) {
+                // 已被DelFd/ModFd替换的旧请求
+                if (cqe.flags & IORING_CQE_F_BUFFER) PutBuffer_(static_cast<std::uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+                continue;
+            }
+
+            Event& ev = m_events[n];
+            ev = {op, fd, st.data, 0, cqe.res, cqe.flags};
+            if (op == UringOp::Poll) {
+                if (cqe.res == -ECANCELED) continue;
+                ev.events = cqe.res < 0 ? EPOLLERR : static_cast<uint32_t>(cqe.res);
+                if (cqe.res < 0 && !(cqe.flags & IORING_CQE_F_MORE)) {
+                    // fd无效或已关闭时重新挂上只会再次失败，报告一次EPOLLERR后停下，由回调DelFd
+                    st.polling = false;
+                    st.failed = true;
+                } else if (!(cqe.flags & IORING_CQE_F_MORE)) {
+                    // oneshot已触发；水平触发的单次poll或被内核终止的multishot重新挂上
+                    if (st.events & EPOLLONESHOT) st.polling = false;
+                    else PrepPoll_(fd, st);
+                }
+            } else if (!(cqe.flags & IORING_CQE_F_MORE)) {
+                if (op == UringOp::Accept) st.accepting = false;
+                else st.receiving = false;
+            }
+            ++n;
+        }
+        std::atomic_ref<unsigned>{*m_cqHead}.store(head, std::memory_order_release);
+        PublishBuffers_();
+        m_eventCount = n;
+        return static_cast<int>(n);
+    }
+
+    void PutBuffer_(std::uint16_t bid) {
+        // C++下__DECLARE_FLEX_ARRAY会让bufs偏移8字节，这里按io_uring_buf数组直接寻址
+        io_uring_buf& buf = reinterpret_cast<io_uring_buf*>(m_bufRing)[m_bufTail & (m_bufCount - 1)];
+        buf.addr = reinterpret_cast<uint64_t>(m_bufBase + static_cast<size_t>(bid) * m_bufSize);
+        buf.len = m_bufSize;
+        buf.bid = bid;
+        ++m_bufTail;
+    }
+
+    void PublishBuffers_() {
+        if (m_bufRing) std::atomic_ref<std::uint16_t>{m_bufRing->tail}.store(m_bufTail, std::memory_order_release);
+    }
+
+    int m_ringFd = -1;
+    void* m_sqPtr = nullptr;
+    void* m_cqPtr = nullptr;
+    size_t m_sqSize = 0;
+    size_t m_cqSize = 0;
+    io_uring_sqe* m_sqes = nullptr;
+    size_t m_sqesSize = 0;
+
+    unsigned* m_sqHead = nullptr;
+    unsigned* m_sqTail = nullptr;
+    unsigned* m_sqArray = nullptr;
+    unsigned m_sqMask = 0;
+    unsigned m_sqEntries = 0;
+    unsigned m_localTail = 0;
+
+    unsigned* m_cqHead = nullptr;
+    unsigned* m_cqTail = nullptr;
+    unsigned m_cqMask = 0;
+    io_uring_cqe* m_cqes = nullptr;
+
+    io_uring_buf_ring* m_bufRing = nullptr;
+    size_t m_bufRingSize = 0;
+    std::uint8_t* m_bufBase = nullptr;
+    unsigned m_bufCount = 0;
+    unsigned m_bufSize = 0;
+    std::uint16_t m_bufTail = 0;
+
+    std::vector<FdState> m_fds;
+    std::vector<Event> m_events;
+    size_t m_eventCount = 0;
+};
+
+#endif //URING_POLLER_H
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UTF8_VALIDATOR_X86 1
+#endif
+
+/*
+ * UTF-8校验(RFC 3629：拒绝过长编码、代理区和大于U+10FFFF的码点)
+ * 整块校验有AVX2实现(Keiser & Lemire的查表法，每32字节几条指令)和标量实现，首次调用时按cpuid选择
+ * Utf8Validator可以分多次喂入数据，跨块边界的不完整字符留到下一次拼接后再校验
+ */
+namespace utf8 {
+
+inline int sequenceLength(std::uint8_t lead) {
+	if (lead < 0x80) return 1;
+	if (lead < 0xC2) return 0;		// 续字节或过长的2字节编码
+	if (lead < 0xE0) return 2;
+	if (lead < 0xF0) return 3;
+	if (lead < 0xF5) return 4;
+	return 0;
+}
+
+inline bool validateScalar(const std::uint8_t* p, std::size_t n) {
+	std::size_t i = 0;
+	while (i < n) {
+		// ASCII一次跳过8字节
+		if (i + 8 <= n) {
+			std::uint64_t v;
+			std::memcpy(&v, p + i, 8);
+			if ((v & 0x8080808080808080ull) == 0) {
+				i += 8;
+				continue;
+			}
+		}
+		std::uint8_t c = p[i];
+		int len = sequenceLength(c);
+		if (len == 0 || i + len > n) return false;
+		if (len == 1) {
+			++i;
+			continue;
+		}
+		std::uint8_t c1 = p[i + 1];
+		// 第二个字节的合法范围取决于首字节
+		std::uint8_t lo = 0x80, hi = 0xBF;
+		if (c == 0xE0) lo = 0xA0;
+		else if (c == 0xED) hi = 0x9F;
+		else if (c == 0xF0) lo = 0x90;
+		else if (c == 0xF4) hi = 0x8F;
+		if (c1 < lo || c1 > hi) return false;
+		for (int k = 2; k < len; ++k) {
+			if ((p[i + k] & 0xC0) != 0x80) return false;
+		}
+		i += len;
+	}
+	return true;
+}
+
+#ifdef UTF8_VALIDATOR_X86
+namespace detail {
+
+constexpr std::uint8_t TOO_SHORT = 1 << 0;
+constexpr std::uint8_t TOO_LONG = 1 << 1;
+constexpr std::uint8_t OVERLONG_3 = 1 << 2;
+constexpr std::uint8_t TOO_LARGE = 1 << 3;
+constexpr std::uint8_t SURROGATE = 1 << 4;
+constexpr std::uint8_t OVERLONG_2 = 1 << 5;
+constexpr std::uint8_t TOO_LARGE_1000 = 1 << 6;
+constexpr std::uint8_t OVERLONG_4 = 1 << 6;
+constexpr std::uint8_t TWO_CONTS = 1 << 7;
+constexpr std::uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+__attribute__((target("avx2")))
+inline __m256i table16(std::uint8_t a0, std::uint8_t a1, std::uint8_t a2, std::uint8_t a3,
+		std::uint8_t a4, std::uint8_t a5, std::uint8_t a6, std::uint8_t a7,
+		std::uint8_t a8, std::uint8_t a9, std::uint8_t a10, std::uint8_t a11,
+		std::uint8_t a12, std::uint8_t a13, std::uint8_t a14, std::uint8_t a15) {
+	return _mm256_setr_epi8(a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15,
+			a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15);
+}
+
+// input中每个字节前面第N个字节，跨越到上一块prev
+template <int N>
+__attribute__((target("avx2")))
+inline __m256i prevBytes(__m256i input, __m256i prev) {
+	return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - N);
+}
+
+__attribute__((target("avx2")))
+inline __m256i shr4(__m256i v) {
+	return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+}
+
+struct Avx2State {
+	__m256i error;
+	__m256i prevInput;
+	__m256i prevIncomplete;
+};
+
+__attribute__((target("avx2")))
+inline void checkBlock(Avx2State& s, __m256i input) {
+	if (_mm256_movemask_epi8(input) == 0) {
+		// 纯ASCII块：只需要上一块没有未完成的字符
+		s.error = _mm256_or_si256(s.error, s.prevIncomplete);
+		s.prevIncomplete = _mm256_setzero_si256();
+		s.prevInput = input;
+		return;
+	}
+	const __m256i byte1HighTable = table16(
+		TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+		TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+		TOO_SHORT | OVERLONG_2,
+		TOO_SHORT,
+		TOO_SHORT | OVERLONG_3 | SURROGATE,
+		TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4);
+	const __m256i byte1LowTable = table16(
+		CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+		CARRY | OVERLONG_2,
+		CARRY,
+		CARRY,
+		CARRY | TOO_LARGE,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000);
+	const __m256i byte2HighTable = table16(
+		TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+		TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+		TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+		TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+		TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+		TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+
+	__m256i prev1 = prevBytes<1>(input, s.prevInput);
+	__m256i byte1High = _mm256_shuffle_epi8(byte1HighTable, shr4(prev1));
+	__m256i byte1Low = _mm256_shuffle_epi8(byte1LowTable, _mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)));
+	__m256i byte2High = _mm256_shuffle_epi8(byte2HighTable, shr4(input));
+	__m256i special = _mm256_and_si256(_mm256_and_si256(byte1High, byte1Low), byte2High);
+
+	// 前面第2/3个字节是3/4字节序列的首字节时，当前字节必须是续字节
+	__m256i prev2 = prevBytes<2>(input, s.prevInput);
+	__m256i prev3 = prevBytes<3>(input, s.prevInput);
+	__m256i third = _mm256_subs_epu8(prev2, _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+	__m256i fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+	__m256i must23 = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(static_cast<char>(0x80)));
+	s.error = _mm256_or_si256(s.error, _mm256_xor_si256(must23, special));
+
+	// 块尾还在等续字节的位置
+	const __m256i maxValue = _mm256_setr_epi8(
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+	s.prevIncomplete = _mm256_subs_epu8(input, maxValue);
+	s.prevInput = input;
+}
+
+__attribute__((target("avx2")))
+inline bool validateAvx2(const std::uint8_t* p, std::size_t n) {
+	Avx2State s{_mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256()};
+	std::size_t i = 0;
+	for (; i + 32 <= n; i += 32) {
+		checkBlock(s, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i)));
+	}
+	if (i < n) {
+		// 尾部补0(ASCII)凑成一块
+		alignas(32) std::uint8_t tail[32] = {};
+		std::memcpy(tail, p + i, n - i);
+		checkBlock(s, _mm256_load_si256(reinterpret_cast<const __m256i*>(tail)));
+	}
+	s.error = _mm256_or_si256(s.error, s.prevIncomplete);
+	return _mm256_testz_si256(s.error, s.error);
+}
+
+} // namespace detail
+#endif
+
+using ValidateFn = bool (*)(const std::uint8_t*, std::size_t);
+
+inline ValidateFn selectValidator() {
+#ifdef UTF8_VALIDATOR_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return detail::validateAvx2;
+	}
+#endif
+	return validateScalar;
+}
+
+// 整块校验，结尾不能有不完整的字符
+inline bool validate(std::span<const std::uint8_t> data) {
+	static const ValidateFn fn = selectValidator();
+	return data.size() < 32 ? validateScalar(data.data(), data.size()) : fn(data.data(), data.size());
+}
+
+} // namespace utf8
+
+class Utf8Validator {
+public:
+	// 校验下一段数据，发现错误返回false，之后一直返回false直到reset
+	bool feed(std::span<const std::uint8_t> data) {
+		if (!m_valid) {
+			return false;
+		}
+		// 先用新数据补全上一段末尾的不完整字符
+		if (m_pendingLen > 0) {
+			std::size_t need = static_cast<std::size_t>(utf8::sequenceLength(m_pending[0])) - m_pendingLen;
+			std::size_t take = std::min(need, data.size());
+			std::memcpy(m_pending + m_pendingLen, data.data(), take);
+			m_pendingLen += take;
+			data = data.subspan(take);
+			if (take < need) {
+				return m_valid = prefixValid();
+			}
+			m_valid = utf8::validateScalar(m_pending, m_pendingLen);
+			m_pendingLen = 0;
+			if (!m_valid) {
+				return false;
+			}
+		}
+
+		std::size_t complete = data.size() - incompleteTail(data);
+		if (!utf8::validate(data.first(complete))) {
+			return m_valid = false;
+		}
+		m_pendingLen = data.size() - complete;
+		std::memcpy(m_pending, data.data() + complete, m_pendingLen);
+		return m_valid = prefixValid();
+	}
+
+	// 消息结束时调用，不能留有不完整的字符
+	bool finish() const { return m_valid && m_pendingLen == 0; }
+
+	void reset() {
+		m_valid = true;
+		m_pendingLen = 0;
+	}
+
+private:
+	// 结尾处首字节已出现但续字节不够的字符长度
+	static std::size_t incompleteTail(std::span<const std::uint8_t> data) {
+		std::size_t n = data.size();
+		for (std::size_t back = 1; back <= 3 && back <= n; ++back) {
+			std::uint8_t c = data[n - back];
+			if ((c & 0xC0) == 0x80) {
+				continue;
+			}
+			int len = utf8::sequenceLength(c);
+			return len > static_cast<int>(back) ? back : 0;
+		}
+		return 0;
+	}
+
+	// 不完整字符的已有部分也要尽早检查，例如ED A0开头的代理区
+	bool prefixValid() const {
+		if (m_pendingLen == 0) {
+			return true;
+		}
+		std::uint8_t buf[4];
+		std::memcpy(buf, m_pending, m_pendingLen);
+		// 用最小的合法续字节补齐后校验
+		std::uint8_t c = m_pending[0];
+		std::size_t len = static_cast<std::size_t>(utf8::sequenceLength(c));
+		for (std::size_t i = m_pendingLen; i < len; ++i) {
+			buf[i] = (i == 1 && (c == 0xE0 || c == 0xF0)) ? (c == 0xE0 ? 0xA0 : 0x90) : 0x80;
+		}
+		return utf8::validateScalar(buf, len);
+	}
+
+	std::uint8_t m_pending[4] = {};
+	std::size_t m_pendingLen = 0;
+	bool m_valid = true;
+};
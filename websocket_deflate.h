@@ -0,0 +1,423 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <zlib.h>
+
+#include "websocket_frame.h"
+#include "websocket_writer.h"
+
+/*
+ * permessage-deflate扩展(RFC 7692)，需要链接zlib(-lz)
+ * 每条消息压缩后去掉结尾的00 00 FF FF，第一帧置RSV1；解压时补回再inflate
+ * 没有上下文保持(no_context_takeover)的一方每条消息从空字典开始，zlib流只在处理消息时从线程内的池里借用，
+ * 连接空闲时不占内存；保持上下文时流只能归连接所有
+ * 服务端不保持上下文时，同一条消息的压缩结果对所有连接都一样，广播时只需压缩一次
+ */
+
+struct PerMessageDeflateConfig {
+	bool serverNoContextTakeover = false;
+	bool clientNoContextTakeover = false;
+	int serverMaxWindowBits = 15;
+	int clientMaxWindowBits = 15;
+	int level = 6;
+	int memLevel = 8;
+	std::size_t threshold = 256;			// 小于此长度的消息不压缩
+};
+
+namespace websocket_deflate {
+
+inline constexpr std::uint8_t kTail[4] = {0x00, 0x00, 0xFF, 0xFF};
+
+// zlib的raw deflate不支持8位窗口
+inline constexpr int kMinWindowBits = 9;
+
+struct StreamDeleter {
+	bool deflater;
+	void operator()(z_stream* z) const {
+		if (deflater) {
+			deflateEnd(z);
+		} else {
+			inflateEnd(z);
+		}
+		delete z;
+	}
+};
+using Stream = std::unique_ptr<z_stream, StreamDeleter>;
+
+inline Stream newDeflater(int windowBits, int level, int memLevel) {
+	Stream z{new z_stream{}, StreamDeleter{true}};
+	if (deflateInit2(z.get(), level, Z_DEFLATED, -std::clamp(windowBits, kMinWindowBits, 15), memLevel, Z_DEFAULT_STRATEGY) != Z_OK) {
+		delete z.release();
+		return nullptr;
+	}
+	return z;
+}
+
+inline Stream newInflater(int windowBits) {
+	Stream z{new z_stream{}, StreamDeleter{false}};
+	if (inflateInit2(z.get(), -std::clamp(windowBits, kMinWindowBits, 15)) != Z_OK) {
+		delete z.release();
+		return nullptr;
+	}
+	return z;
+}
+
+/*
+ * 线程内的zlib流池，只缓存默认参数的流，最多kPoolSize个
+ * 每个deflate流约256KB(window 15, memLevel 8)，池的上限就是空闲时的内存上限
+ */
+class StreamPool {
+public:
+	static constexpr std::size_t kPoolSize = 8;
+
+	static StreamPool& local() {
+		static thread_local StreamPool pool;
+		return pool;
+	}
+
+	Stream acquireDeflater(int windowBits, int level, int memLevel) {
+		if (windowBits == 15 && level == kLevel && memLevel == kMemLevel && !m_deflaters.empty()) {
+			Stream z = std::move(m_deflaters.back());
+			m_deflaters.pop_back();
+			return z;
+		}
+		return newDeflater(windowBits, level, memLevel);
+	}
+
+	Stream acquireInflater(int windowBits) {
+		if (windowBits == 15 && !m_inflaters.empty()) {
+			Stream z = std::move(m_inflaters.back());
+			m_inflaters.pop_back();
+			return z;
+		}
+		return newInflater(windowBits);
+	}
+
+	void release(Stream z, bool deflater, int windowBits, int level = kLevel, int memLevel = kMemLevel) {
+		if (!z || windowBits != 15) {
+			return;
+		}
+		if (deflater && level == kLevel && memLevel == kMemLevel && m_deflaters.size() < kPoolSize) {
+			deflateReset(z.get());
+			m_deflaters.push_back(std::move(z));
+		} else if (!deflater && m_inflaters.size() < kPoolSize) {
+			inflateReset(z.get());
+			m_inflaters.push_back(std::move(z));
+		}
+	}
+
+private:
+	static constexpr int kLevel = 6;
+	static constexpr int kMemLevel = 8;
+
+	std::vector<Stream> m_deflaters;
+	std::vector<Stream> m_inflaters;
+};
+
+// 压缩一条完整消息并追加到out，去掉结尾的00 00 FF FF
+inline bool deflateMessage(z_stream* z, std::span<const std::uint8_t> in, std::vector<std::uint8_t>& out) {
+	std::size_t start = out.size();
+	z->next_in = const_cast<Bytef*>(in.data());
+	z->avail_in = static_cast<uInt>(in.size());
+	do {
+		std::size_t room = std::max<std::size_t>(deflateBound(z, z->avail_in) + 16, 64);
+		std::size_t used = out.size();
+		out.resize(used + room);
+		z->next_out = out.data() + used;
+		z->avail_out = static_cast<uInt>(room);
+		if (deflate(z, Z_SYNC_FLUSH) == Z_STREAM_ERROR) {
+			out.resize(start);
+			return false;
+		}
+		out.resize(used + room - z->avail_out);
+	} while (z->avail_out == 0 || z->avail_in > 0);
+	if (out.size() - start >= 4 && std::equal(std::begin(kTail), std::end(kTail), out.end() - 4)) {
+		out.resize(out.size() - 4);
+	}
+	return true;
+}
+
+/*
+ * 压缩输出用的线程内暂存区，每条消息压缩进这里再拷进EncodedFrame，不再每条消息分配一个vector
+ * 用完调用releaseScratch，超过kScratchKeep的容量还给系统
+ */
+inline constexpr std::size_t kScratchKeep = 256 * 1024;
+
+inline std::vector<std::uint8_t>& scratch() {
+	static thread_local std::vector<std::uint8_t> buffer;
+	buffer.clear();
+	return buffer;
+}
+
+inline void releaseScratch(std::vector<std::uint8_t>& buffer) {
+	if (buffer.capacity() > kScratchKeep) {
+		std::vector<std::uint8_t>().swap(buffer);
+	}
+}
+
+enum class InflateStatus : std::uint8_t {
+	Ok,
+	Corrupt,
+	TooLarge
+};
+
+// 解压一条完整消息并追加到out，失败时out恢复原样
+inline InflateStatus inflateMessage(z_stream* z, std::span<const std::uint8_t> in, std::vector<std::uint8_t>& out, std::size_t maxSize) {
+	std::size_t start = out.size();
+	for (std::span<const std::uint8_t> part : {in, std::span<const std::uint8_t>(kTail)}) {
+		z->next_in = const_cast<Bytef*>(part.data());
+		z->avail_in = static_cast<uInt>(part.size());
+		do {
+			std::size_t used = out.size();
+			// 最多多解出1字节，用来判断是否超限
+			std::size_t room = std::min(std::max<std::size_t>(part.size() * 4, 4096), maxSize + 1 - (used - start));
+			out.resize(used + room);
+			z->next_out = out.data() + used;
+			z->avail_out = static_cast<uInt>(room);
+			int ret = inflate(z, Z_SYNC_FLUSH);
+			out.resize(used + room - z->avail_out);
+			if (out.size() - start > maxSize) {
+				out.resize(start);
+				return InflateStatus::TooLarge;
+			}
+			if (ret != Z_OK && ret != Z_BUF_ERROR && ret != Z_STREAM_END) {
+				out.resize(start);
+				return InflateStatus::Corrupt;
+			}
+			if (ret == Z_STREAM_END) {
+				// 对端用BFINAL结束了这条消息，之后的数据(补上的结尾)忽略
+				inflateReset(z);
+				return InflateStatus::Ok;
+			}
+			if (ret == Z_BUF_ERROR && z->avail_out > 0) {
+				break;
+			}
+		} while (z->avail_in > 0 || z->avail_out == 0);
+	}
+	return InflateStatus::Ok;
+}
+
+// "a=1" -> ("a", "1")，去掉空白和引号
+inline std::pair<std::string_view, std::string_view> splitParam(std::string_view param) {
+	auto trim = [](std::string_view s) {
+		while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+		while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+		if (s.size() >= 2 && s.front() == '"' && s.back() == '"') s = s.substr(1, s.size() - 2);
+		return s;
+	};
+	std::size_t eq = param.find('=');
+	if (eq == std::string_view::npos) {
+		return {trim(param), {}};
+	}
+	return {trim(param.substr(0, eq)), trim(param.substr(eq + 1))};
+}
+
+inline bool parseWindowBits(std::string_view value, int& bits) {
+	auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), bits);
+	return ec == std::errc{} && ptr == value.data() + value.size() && bits >= 8 && bits <= 15;
+}
+
+// 按服务端策略处理一个offer，接受时填好agreed和响应
+inline bool acceptOffer(std::string_view offer, const PerMessageDeflateConfig& policy,
+		PerMessageDeflateConfig& agreed, std::string& response) {
+	agreed = policy;
+	bool clientBitsOffered = false;
+	int clientBits = 15;
+	unsigned seen = 0;
+	std::size_t pos = 0;
+	while (pos != std::string_view::npos) {
+		std::size_t semi = offer.find(';', pos);
+		auto [name, value] = splitParam(offer.substr(pos, semi == std::string_view::npos ? semi : semi - pos));
+		pos = semi == std::string_view::npos ? semi : semi + 1;
+		if (name.empty()) {
+			continue;
+		}
+		unsigned bit;
+		if (name == "server_no_context_takeover" && value.empty()) {
+			bit = 1;
+			agreed.serverNoContextTakeover = true;
+		} else if (name == "client_no_context_takeover" && value.empty()) {
+			bit = 2;
+			agreed.clientNoContextTakeover = true;
+		} else if (name == "server_max_window_bits") {
+			bit = 4;
+			int bits;
+			if (!parseWindowBits(value, bits)) {
+				return false;
+			}
+			agreed.serverMaxWindowBits = std::min(policy.serverMaxWindowBits, bits);
+			// 压缩端用不了8位窗口，拒绝这个offer
+			if (agreed.serverMaxWindowBits < kMinWindowBits) {
+				return false;
+			}
+		} else if (name == "client_max_window_bits") {
+			bit = 8;
+			clientBitsOffered = true;
+			if (!value.empty() && !parseWindowBits(value, clientBits)) {
+				return false;
+			}
+		} else {
+			return false;
+		}
+		// 参数重复时拒绝这个offer
+		if (seen & bit) {
+			return false;
+		}
+		seen |= bit;
+	}
+	// 客户端不支持client_max_window_bits时只能用15
+	agreed.clientMaxWindowBits = clientBitsOffered ? std::min(policy.clientMaxWindowBits, clientBits) : 15;
+	if (!clientBitsOffered && policy.clientMaxWindowBits < 15) {
+		return false;
+	}
+
+	response = "permessage-deflate";
+	if (agreed.serverNoContextTakeover) response += "; server_no_context_takeover";
+	if (agreed.clientNoContextTakeover) response += "; client_no_context_takeover";
+	if (agreed.serverMaxWindowBits < 15) response += "; server_max_window_bits=" + std::to_string(agreed.serverMaxWindowBits);
+	if (clientBitsOffered && agreed.clientMaxWindowBits < 15) response += "; client_max_window_bits=" + std::to_string(agreed.clientMaxWindowBits);
+	return true;
+}
+
+} // namespace websocket_deflate
+
+/*
+ * 协商：extensions为客户端的Sec-WebSocket-Extensions，policy为服务端愿意接受的上限
+ * 按顺序接受第一个可以满足的permessage-deflate offer，response为应回复的扩展头的值
+ */
+inline bool negotiatePerMessageDeflate(std::string_view extensions, const PerMessageDeflateConfig& policy,
+		PerMessageDeflateConfig& agreed, std::string& response) {
+	std::size_t pos = 0;
+	while (pos != std::string_view::npos) {
+		std::size_t comma = extensions.find(',', pos);
+		std::string_view offer = extensions.substr(pos, comma == std::string_view::npos ? comma : comma - pos);
+		pos = comma == std::string_view::npos ? comma : comma + 1;
+		std::size_t semi = offer.find(';');
+		auto [name, value] = websocket_deflate::splitParam(offer.substr(0, semi));
+		if (name != "permessage-deflate") {
+			continue;
+		}
+		std::string_view params = semi == std::string_view::npos ? std::string_view{} : offer.substr(semi + 1);
+		if (websocket_deflate::acceptOffer(params, policy, agreed, response)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// 一个连接上协商好的permessage-deflate状态
+class PerMessageDeflate {
+public:
+	explicit PerMessageDeflate(const PerMessageDeflateConfig& config) : m_config{config} {}
+
+	~PerMessageDeflate() {
+		auto& pool = websocket_deflate::StreamPool::local();
+		pool.release(std::move(m_deflater), true, m_config.serverMaxWindowBits, m_config.level, m_config.memLevel);
+		pool.release(std::move(m_inflater), false, m_config.clientMaxWindowBits);
+	}
+
+	const PerMessageDeflateConfig& config() const { return m_config; }
+
+	// 压缩发往客户端的消息，结果追加到out；低于阈值或压缩后不更小时返回false，应原样发送
+	bool compress(std::span<const std::uint8_t> in, std::vector<std::uint8_t>& out) {
+		if (in.size() < m_config.threshold) {
+			return false;
+		}
+		auto& pool = websocket_deflate::StreamPool::local();
+		if (!m_deflater) {
+			m_deflater = pool.acquireDeflater(m_config.serverMaxWindowBits, m_config.level, m_config.memLevel);
+			if (!m_deflater) {
+				return false;
+			}
+		}
+		std::size_t start = out.size();
+		bool ok = websocket_deflate::deflateMessage(m_deflater.get(), in, out);
+		if (!ok) {
+			// 出错的流不能再用
+			m_deflater.reset();
+			out.resize(start);
+			return false;
+		}
+		if (!m_config.serverNoContextTakeover) {
+			// 这条消息已进入压缩字典，必须发送压缩结果，否则两端字典不一致
+			return true;
+		}
+		// 没有上下文的流用完就还回池里
+		pool.release(std::move(m_deflater), true, m_config.serverMaxWindowBits, m_config.level, m_config.memLevel);
+		if (out.size() - start >= in.size()) {
+			out.resize(start);
+			return false;
+		}
+		return true;
+	}
+
+	// 解压客户端发来的消息，结果追加到out
+	websocket_deflate::InflateStatus decompress(std::span<const std::uint8_t> in, std::vector<std::uint8_t>& out, std::size_t maxSize) {
+		using websocket_deflate::InflateStatus;
+		auto& pool = websocket_deflate::StreamPool::local();
+		if (!m_inflater) {
+			m_inflater = pool.acquireInflater(m_config.clientMaxWindowBits);
+			if (!m_inflater) {
+				return InflateStatus::Corrupt;
+			}
+		}
+		InflateStatus status = websocket_deflate::inflateMessage(m_inflater.get(), in, out, maxSize);
+		if (status != InflateStatus::Ok) {
+			m_inflater.reset();
+		} else if (m_config.clientNoContextTakeover) {
+			pool.release(std::move(m_inflater), false, m_config.clientMaxWindowBits);
+		}
+		return status;
+	}
+
+	// 构造一条消息的帧，按需压缩
+	EncodedFrameRef buildFrame(WebSocketOpcode opcode, std::span<const std::uint8_t> payload) {
+		std::vector<std::uint8_t>& compressed = websocket_deflate::scratch();
+		EncodedFrameRef frame = compress(payload, compressed) ? EncodedFrame::make(opcode, compressed, true, true)
+			: EncodedFrame::make(opcode, payload);
+		websocket_deflate::releaseScratch(compressed);
+		return frame;
+	}
+
+	// 能否直接发送用windowBits位窗口、无上下文压缩好的共享帧
+	bool canShare(int windowBits) const {
+		return m_config.serverNoContextTakeover && m_config.serverMaxWindowBits >= windowBits;
+	}
+
+private:
+	PerMessageDeflateConfig m_config;
+	websocket_deflate::Stream m_deflater;
+	websocket_deflate::Stream m_inflater;
+};
+
+/*
+ * 广播：无上下文压缩一次，得到的帧可以发给所有canShare(windowBits)的连接，其余连接各自buildFrame
+ * 返回false表示不值得压缩(低于阈值或压缩后不更小)
+ */
+inline bool buildSharedDeflateFrame(WebSocketOpcode opcode, std::span<const std::uint8_t> payload,
+		EncodedFrameRef& frame, int windowBits = 15, std::size_t threshold = 256) {
+	if (payload.size() < threshold) {
+		return false;
+	}
+	auto& pool = websocket_deflate::StreamPool::local();
+	websocket_deflate::Stream z = pool.acquireDeflater(windowBits, 6, 8);
+	if (!z) {
+		return false;
+	}
+	std::vector<std::uint8_t>& compressed = websocket_deflate::scratch();
+	bool ok = websocket_deflate::deflateMessage(z.get(), payload, compressed);
+	pool.release(std::move(z), true, windowBits);
+	ok = ok && compressed.size() < payload.size();
+	if (ok) {
+		frame = EncodedFrame::make(opcode, compressed, true, true);
+	}
+	websocket_deflate::releaseScratch(compressed);
+	return ok;
+}
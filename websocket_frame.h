@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+#include "websocket_mask.h"
+
+// WebSocket操作码
+enum class WebSocketOpcode : std::uint8_t {
+	Continuation = 0x0,
+	Text = 0x1,
+	Binary = 0x2,
+	Close = 0x8,
+	Ping = 0x9,
+	Pong = 0xA
+};
+
+inline bool isControlOpcode(WebSocketOpcode opcode) {
+	return static_cast<std::uint8_t>(opcode) & 0x8;
+}
+
+// 解析出的一帧，payload指向连接读缓冲区里已去掉掩码的数据，在缓冲区被改写前有效
+struct WebSocketFrame {
+	WebSocketOpcode opcode = WebSocketOpcode::Continuation;
+	bool fin = false;
+	bool masked = false;
+	std::uint8_t rsv = 0;			// RSV1-3，保持在首字节中的位置：0x40/0x20/0x10
+	std::uint64_t length = 0;
+	std::span<std::uint8_t> payload;
+};
+
+// 按掩码键原地异或，offset为data第一个字节在整个载荷中的位置
+inline void applyWebSocketMask(std::span<std::uint8_t> data, std::uint32_t key, std::size_t offset = 0) {
+	websocket_mask::apply(data, key, offset);
+}
+
+// 编码好的帧头，最长14字节：2字节基本头 + 8字节扩展长度 + 4字节掩码键
+struct WebSocketFrameHeader {
+	std::uint8_t bytes[14];
+	std::uint8_t size = 0;
+
+	std::span<const std::uint8_t> view() const { return {bytes, size}; }
+};
+
+// 按载荷长度编码帧头；mask为true时写入maskKey，载荷由调用方用同一个key加掩码
+inline WebSocketFrameHeader encodeWebSocketHeader(WebSocketOpcode opcode, std::uint64_t length,
+		bool fin = true, bool compressed = false, bool mask = false, std::uint32_t maskKey = 0) {
+	WebSocketFrameHeader header;
+	std::uint8_t* p = header.bytes;
+	*p++ = static_cast<std::uint8_t>(static_cast<std::uint8_t>(opcode) | (fin ? 0x80 : 0) | (compressed ? 0x40 : 0));
+	std::uint8_t maskBit = mask ? 0x80 : 0;
+	if (length <= 125) {
+		*p++ = static_cast<std::uint8_t>(maskBit | length);
+	} else if (length <= 65535) {
+		*p++ = maskBit | 126;
+		*p++ = static_cast<std::uint8_t>(length >> 8);
+		*p++ = static_cast<std::uint8_t>(length);
+	} else {
+		*p++ = maskBit | 127;
+		for (int shift = 56; shift >= 0; shift -= 8) {
+			*p++ = static_cast<std::uint8_t>(length >> shift);
+		}
+	}
+	if (mask) {
+		std::memcpy(p, &maskKey, sizeof(maskKey));
+		p += sizeof(maskKey);
+	}
+	header.size = static_cast<std::uint8_t>(p - header.bytes);
+	return header;
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "http_parser.h"
+#include "websocket_deflate.h"
+
+/*
+ * WebSocket握手(RFC 6455 4.2)：校验Upgrade请求，用SHA-1 + base64算出Sec-WebSocket-Accept，
+ * 构造101响应；同时协商permessage-deflate
+ */
+namespace websocket_handshake {
+
+inline constexpr std::string_view kGuid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// 只用于握手，输入很短，不做增量接口
+inline std::array<std::uint8_t, 20> sha1(std::string_view a, std::string_view b = {}) {
+	std::uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+	std::uint64_t totalBits = static_cast<std::uint64_t>(a.size() + b.size()) * 8;
+
+	auto compress = [&h](const std::uint8_t* block) {
+		std::uint32_t w[80];
+		for (int i = 0; i < 16; ++i) {
+			w[i] = static_cast<std::uint32_t>(block[i * 4]) << 24 | static_cast<std::uint32_t>(block[i * 4 + 1]) << 16 |
+				static_cast<std::uint32_t>(block[i * 4 + 2]) << 8 | block[i * 4 + 3];
+		}
+		for (int i = 16; i < 80; ++i) {
+			w[i] = std::rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+		}
+		std::uint32_t x0 = h[0], x1 = h[1], x2 = h[2], x3 = h[3], x4 = h[4];
+		for (int i = 0; i < 80; ++i) {
+			std::uint32_t f, k;
+			if (i < 20) {
+				f = (x1 & x2) | (~x1 & x3);
+				k = 0x5A827999;
+			} else if (i < 40) {
+				f = x1 ^ x2 ^ x3;
+				k = 0x6ED9EBA1;
+			} else if (i < 60) {
+				f = (x1 & x2) | (x1 & x3) | (x2 & x3);
+				k = 0x8F1BBCDC;
+			} else {
+				f = x1 ^ x2 ^ x3;
+				k = 0xCA62C1D6;
+			}
+			std::uint32_t t = std::rotl(x0, 5) + f + x4 + k + w[i];
+			x4 = x3;
+			x3 = x2;
+			x2 = std::rotl(x1, 30);
+			x1 = x0;
+			x0 = t;
+		}
+		h[0] += x0;
+		h[1] += x1;
+		h[2] += x2;
+		h[3] += x3;
+		h[4] += x4;
+	};
+
+	std::uint8_t block[64];
+	std::size_t used = 0;
+	for (std::string_view part : {a, b}) {
+		for (char c : part) {
+			block[used++] = static_cast<std::uint8_t>(c);
+			if (used == 64) {
+				compress(block);
+				used = 0;
+			}
+		}
+	}
+	block[used++] = 0x80;
+	if (used > 56) {
+		std::memset(block + used, 0, 64 - used);
+		compress(block);
+		used = 0;
+	}
+	std::memset(block + used, 0, 56 - used);
+	for (int i = 0; i < 8; ++i) {
+		block[56 + i] = static_cast<std::uint8_t>(totalBits >> (56 - i * 8));
+	}
+	compress(block);
+
+	std::array<std::uint8_t, 20> digest;
+	for (int i = 0; i < 5; ++i) {
+		digest[i * 4] = static_cast<std::uint8_t>(h[i] >> 24);
+		digest[i * 4 + 1] = static_cast<std::uint8_t>(h[i] >> 16);
+		digest[i * 4 + 2] = static_cast<std::uint8_t>(h[i] >> 8);
+		digest[i * 4 + 3] = static_cast<std::uint8_t>(h[i]);
+	}
+	return digest;
+}
+
+inline constexpr char kBase64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// 20字节摘要编码后固定28个字符
+inline std::array<char, 28> base64(const std::array<std::uint8_t, 20>& in) {
+	std::array<char, 28> out;
+	std::size_t o = 0;
+	std::size_t i = 0;
+	for (; i + 3 <= in.size(); i += 3) {
+		std::uint32_t v = static_cast<std::uint32_t>(in[i]) << 16 | in[i + 1] << 8 | in[i + 2];
+		out[o++] = kBase64[v >> 18];
+		out[o++] = kBase64[(v >> 12) & 63];
+		out[o++] = kBase64[(v >> 6) & 63];
+		out[o++] = kBase64[v & 63];
+	}
+	// 剩下2字节
+	std::uint32_t v = static_cast<std::uint32_t>(in[i]) << 16 | in[i + 1] << 8;
+	out[o++] = kBase64[v >> 18];
+	out[o++] = kBase64[(v >> 12) & 63];
+	out[o++] = kBase64[(v >> 6) & 63];
+	out[o++] = '=';
+	return out;
+}
+
+// Sec-WebSocket-Key必须是16字节随机数的base64，即22个字符加"=="
+inline bool isValidKey(std::string_view key) {
+	if (key.size() != 24 || key[22] != '=' || key[23] != '=') {
+		return false;
+	}
+	for (char c : key.substr(0, 22)) {
+		if (std::memchr(kBase64, c, 64) == nullptr) {
+			return false;
+		}
+	}
+	return true;
+}
+
+} // namespace websocket_handshake
+
+inline std::array<char, 28> computeWebSocketAccept(std::string_view key) {
+	return websocket_handshake::base64(websocket_handshake::sha1(key, websocket_handshake::kGuid));
+}
+
+// Upgrade列表里有websocket的升级请求；升级到其他协议(如curl --http2发的h2c)的请求可以忽略Upgrade，
+// 当作普通请求处理(RFC 9110 §7.8)
+inline bool isWebSocketUpgrade(const HttpRequest& req) {
+	return req.upgrade && http_parse::hasToken(req.header("Upgrade"), "websocket");
+}
+
+/*
+ * 校验Upgrade请求并构造101响应，成功返回101，否则返回应回复的状态码(400或426)
+ * deflatePolicy非空时协商permessage-deflate，协商成功时deflate里是双方同意的参数
+ */
+inline int acceptWebSocketUpgrade(const HttpRequest& req, std::string& response,
+		const PerMessageDeflateConfig* deflatePolicy, std::optional<PerMessageDeflateConfig>& deflate) {
+	deflate.reset();
+	if (req.method != "GET" || req.versionMinor < 1 || !isWebSocketUpgrade(req)) {
+		return 400;
+	}
+	if (req.header("Sec-WebSocket-Version") != "13") {
+		return 426;
+	}
+	std::string_view key = req.header("Sec-WebSocket-Key");
+	if (!websocket_handshake::isValidKey(key)) {
+		return 400;
+	}
+
+	std::array<char, 28> accept = computeWebSocketAccept(key);
+	response.assign("HTTP/1.1 101 Switching Protocols\r\n"
+		"Upgrade: websocket\r\n"
+		"Connection: Upgrade\r\n"
+		"Sec-WebSocket-Accept: ");
+	response.append(accept.data(), accept.size());
+	response += "\r\n";
+	std::string_view extensions = req.header("Sec-WebSocket-Extensions");
+	std::string agreedExtension;
+	PerMessageDeflateConfig agreed;
+	if (deflatePolicy && !extensions.empty() &&
+			negotiatePerMessageDeflate(extensions, *deflatePolicy, agreed, agreedExtension)) {
+		response += "Sec-WebSocket-Extensions: ";
+		response += agreedExtension;
+		response += "\r\n";
+		deflate = agreed;
+	}
+	response += "\r\n";
+	return 101;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <span>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define WEBSOCKET_MASK_X86 1
+#endif
+
+/*
+ * WebSocket掩码内核：原地异或，按首次调用时cpuid检测的结果选用AVX-512/AVX2/SSE2或8字节标量实现
+ * key为按线路字节序memcpy得到的4字节掩码键，offset为data首字节在载荷中的位置，
+ * 起点不是4的倍数时先把key旋转到对应的字节
+ */
+namespace websocket_mask {
+
+// 小端下key的第0字节在最低位，从第n个字节开始相当于右旋8n位
+inline std::uint32_t rotateKey(std::uint32_t key, std::size_t offset) {
+	static_assert(std::endian::native == std::endian::little);
+	return std::rotr(key, static_cast<int>((offset & 3) * 8));
+}
+
+inline void maskBytes(std::uint8_t* p, std::size_t n, std::uint32_t key) {
+	auto k = reinterpret_cast<const std::uint8_t*>(&key);
+	for (std::size_t i = 0; i < n; ++i) {
+		p[i] ^= k[i & 3];
+	}
+}
+
+// 先按字节对齐到8字节边界，再每次处理8字节
+inline void maskScalar(std::uint8_t* p, std::size_t n, std::uint32_t key) {
+	std::size_t head = (8 - (reinterpret_cast<std::uintptr_t>(p) & 7)) & 7;
+	if (head > n) {
+		head = n;
+	}
+	maskBytes(p, head, key);
+	p += head;
+	n -= head;
+	key = rotateKey(key, head);
+	std::uint64_t k64 = static_cast<std::uint64_t>(key) << 32 | key;
+	for (; n >= 8; p += 8, n -= 8) {
+		std::uint64_t v;
+		std::memcpy(&v, p, 8);
+		v ^= k64;
+		std::memcpy(p, &v, 8);
+	}
+	maskBytes(p, n, key);
+}
+
+#ifdef WEBSOCKET_MASK_X86
+// 向量宽度都是4的倍数，整块处理时key不需要再旋转
+__attribute__((target("sse2")))
+inline void maskSse2(std::uint8_t* p, std::size_t n, std::uint32_t key) {
+	__m128i k = _mm_set1_epi32(static_cast<int>(key));
+	for (; n >= 16; p += 16, n -= 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_xor_si128(v, k));
+	}
+	maskScalar(p, n, key);
+}
+
+__attribute__((target("avx2")))
+inline void maskAvx2(std::uint8_t* p, std::size_t n, std::uint32_t key) {
+	__m256i k = _mm256_set1_epi32(static_cast<int>(key));
+	for (; n >= 64; p += 64, n -= 64) {
+		__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm256_xor_si256(a, k));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(p + 32), _mm256_xor_si256(b, k));
+	}
+	for (; n >= 32; p += 32, n -= 32) {
+		__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm256_xor_si256(a, k));
+	}
+	maskScalar(p, n, key);
+}
+
+// 尾部用掩码加载/存储，不回退到标量
+__attribute__((target("avx512f,avx512bw")))
+inline void maskAvx512(std::uint8_t* p, std::size_t n, std::uint32_t key) {
+	__m512i k = _mm512_set1_epi32(static_cast<int>(key));
+	for (; n >= 64; p += 64, n -= 64) {
+		__m512i v = _mm512_loadu_si512(p);
+		_mm512_storeu_si512(p, _mm512_xor_si512(v, k));
+	}
+	if (n > 0) {
+		__mmask64 m = (1ull << n) - 1;
+		__m512i v = _mm512_maskz_loadu_epi8(m, p);
+		_mm512_mask_storeu_epi8(p, m, _mm512_xor_si512(v, k));
+	}
+}
+#endif
+
+using MaskFn = void (*)(std::uint8_t*, std::size_t, std::uint32_t);
+
+inline MaskFn selectKernel() {
+#ifdef WEBSOCKET_MASK_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512bw")) {
+		return maskAvx512;
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		return maskAvx2;
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		return maskSse2;
+	}
+#endif
+	return maskScalar;
+}
+
+// 小于一个向量的数据直接按字节处理，省掉间接调用
+inline constexpr std::size_t kSmallMask = 16;
+
+inline void apply(std::span<std::uint8_t> data, std::uint32_t key, std::size_t offset = 0) {
+	static const MaskFn kernel = selectKernel();
+	key = rotateKey(key, offset);
+	if (data.size() < kSmallMask) {
+		maskBytes(data.data(), data.size(), key);
+	} else {
+		kernel(data.data(), data.size(), key);
+	}
+}
+
+// 客户端帧的掩码键：每个线程一个splitmix64，种子在线程第一次使用时从random_device取一次
+inline std::uint32_t randomKey() {
+	thread_local std::uint64_t state = [] {
+		std::random_device rd;
+		return static_cast<std::uint64_t>(rd()) << 32 | rd();
+	}();
+	std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return static_cast<std::uint32_t>((z ^ (z >> 31)) >> 32);
+}
+
+} // namespace websocket_mask
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "websocket_frame.h"
+#include "websocket_parse.h"
+#include "utf8_validator.h"
+#include "websocket_deflate.h"
+
+enum class WebSocketMessageStatus : std::uint8_t {
+	Message,		// 一条完整的Text/Binary消息
+	Control,		// 一个控制帧(Ping/Pong/Close)，可以出现在分片消息中间
+	NeedMore,
+	Error			// 应以closeCode()关闭连接
+};
+
+struct WebSocketMessage {
+	WebSocketOpcode opcode = WebSocketOpcode::Binary;
+	std::span<std::uint8_t> payload;
+};
+
+/*
+ * 消息层：在帧解析之上拼接分片消息、校验Text消息的UTF-8
+ * 未分片的消息直接指向读缓冲区，不拷贝；分片消息拼接到本对象的缓冲区里，下次调用parse前有效
+ * 分片的UTF-8校验随每个分片增量进行，不等整条消息到齐
+ * 协商了permessage-deflate时，第一帧带RSV1的消息整条拼好后解压到本对象的缓冲区，UTF-8在解压后校验
+ */
+class WebSocketMessageAssembler {
+public:
+	explicit WebSocketMessageAssembler(std::size_t maxMessage = 16 * 1024 * 1024, bool requireMask = true)
+		: m_parser{requireMask, maxMessage}, m_maxMessage{maxMessage} {}
+
+	// 从data开头解析，最多返回一条消息或一个控制帧；consumed为用掉的字节数
+	WebSocketMessageStatus parse(std::span<std::uint8_t> data, std::size_t& consumed, WebSocketMessage& msg) {
+		consumed = 0;
+		if (m_delivered) {
+			m_buffer.clear();
+			m_delivered = false;
+		}
+		while (true) {
+			std::size_t used;
+			WebSocketFrame frame;
+			WebSocketParseStatus status = m_parser.parse(data.subspan(consumed), used, frame);
+			consumed += used;
+			if (status == WebSocketParseStatus::NeedMore) {
+				return WebSocketMessageStatus::NeedMore;
+			}
+			if (status == WebSocketParseStatus::Error) {
+				return fail(m_parser.closeCode());
+			}
+
+			// 只有数据消息的第一帧可以置RSV1
+			if (frame.rsv && (isControlOpcode(frame.opcode) || frame.opcode == WebSocketOpcode::Continuation)) {
+				return fail(1002);
+			}
+			if (isControlOpcode(frame.opcode)) {
+				if (frame.opcode == WebSocketOpcode::Close) {
+					if (std::uint16_t code = checkClosePayload(frame.payload)) {
+						return fail(code);
+					}
+				}
+				msg.opcode = frame.opcode;
+				msg.payload = frame.payload;
+				return WebSocketMessageStatus::Control;
+			}
+
+			bool continuation = frame.opcode == WebSocketOpcode::Continuation;
+			if (continuation != m_assembling) {
+				// 分片中间来了新消息，或者没有分片消息时来了续帧
+				return fail(1002);
+			}
+			if (!continuation) {
+				m_opcode = frame.opcode;
+				m_compressed = frame.rsv & 0x40;
+				m_utf8.reset();
+			}
+			if (m_compressed) {
+				WebSocketMessageStatus status = assembleCompressed(frame, msg);
+				if (status == WebSocketMessageStatus::NeedMore) {
+					continue;
+				}
+				return status;
+			}
+			if (m_opcode == WebSocketOpcode::Text && !m_utf8.feed(frame.payload)) {
+				return fail(1007);
+			}
+
+			if (!continuation && frame.fin) {
+				// 未分片：直接交出读缓冲区里的数据
+				if (m_opcode == WebSocketOpcode::Text && !m_utf8.finish()) {
+					return fail(1007);
+				}
+				msg.opcode = m_opcode;
+				msg.payload = frame.payload;
+				return WebSocketMessageStatus::Message;
+			}
+
+			if (m_buffer.size() + frame.payload.size() > m_maxMessage) {
+				return fail(1009);
+			}
+			m_buffer.insert(m_buffer.end(), frame.payload.begin(), frame.payload.end());
+			m_assembling = !frame.fin;
+			if (frame.fin) {
+				if (m_opcode == WebSocketOpcode::Text && !m_utf8.finish()) {
+					return fail(1007);
+				}
+				msg.opcode = m_opcode;
+				msg.payload = m_buffer;
+				m_delivered = true;
+				return WebSocketMessageStatus::Message;
+			}
+		}
+	}
+
+	// 协商了permessage-deflate后设置，deflate的生命期由连接管理
+	void setDeflate(PerMessageDeflate* deflate) {
+		m_deflate = deflate;
+		m_parser.setAllowedRsv(deflate ? 0x40 : 0);
+	}
+
+	std::uint16_t closeCode() const { return m_closeCode; }
+
+	std::uint64_t pendingPayload() const { return m_parser.pendingPayload(); }
+
+	// 释放已交出的消息占用的缓冲区，连接处理完一批数据后调用，空闲连接不保留拼接和解压用的内存
+	// 分片消息拼接到一半时不释放
+	void trim() {
+		if (m_assembling) {
+			return;
+		}
+		std::vector<std::uint8_t>().swap(m_buffer);
+		std::vector<std::uint8_t>().swap(m_inflated);
+		m_delivered = false;
+	}
+
+private:
+	// Close帧载荷为空，或2字节状态码加UTF-8原因；合法返回0，否则返回应使用的关闭码
+	static std::uint16_t checkClosePayload(std::span<const std::uint8_t> payload) {
+		if (payload.empty()) {
+			return 0;
+		}
+		if (payload.size() < 2) {
+			return 1002;
+		}
+		std::uint16_t code = static_cast<std::uint16_t>(payload[0] << 8 | payload[1]);
+		bool known = (code >= 1000 && code <= 1003) || (code >= 1007 && code <= 1011) || (code >= 3000 && code <= 4999);
+		if (!known) {
+			return 1002;
+		}
+		return utf8::validate(payload.subspan(2)) ? 0 : 1007;
+	}
+
+	// 压缩消息：分片先原样拼接，最后一帧到达后整体解压；还要等后续分片时返回NeedMore
+	// 未分片的压缩消息直接从读缓冲区解压，不先拷贝
+	WebSocketMessageStatus assembleCompressed(const WebSocketFrame& frame, WebSocketMessage& msg) {
+		std::span<const std::uint8_t> compressed = frame.payload;
+		if (m_assembling || !frame.fin) {
+			if (m_buffer.size() + frame.payload.size() > m_maxMessage) {
+				return fail(1009);
+			}
+			m_buffer.insert(m_buffer.end(), frame.payload.begin(), frame.payload.end());
+			compressed = m_buffer;
+		}
+		m_assembling = !frame.fin;
+		if (!frame.fin) {
+			return WebSocketMessageStatus::NeedMore;
+		}
+		m_inflated.clear();
+		m_delivered = true;
+		switch (m_deflate->decompress(compressed, m_inflated, m_maxMessage)) {
+		case websocket_deflate::InflateStatus::TooLarge:
+			return fail(1009);
+		case websocket_deflate::InflateStatus::Corrupt:
+			return fail(1007);
+		default:
+			break;
+		}
+		if (m_opcode == WebSocketOpcode::Text && !utf8::validate(m_inflated)) {
+			return fail(1007);
+		}
+		msg.opcode = m_opcode;
+		msg.payload = m_inflated;
+		return WebSocketMessageStatus::Message;
+	}
+
+	WebSocketMessageStatus fail(std::uint16_t code) {
+		m_closeCode = code;
+		return WebSocketMessageStatus::Error;
+	}
+
+	WebSocketFrameParser m_parser;
+	std::size_t m_maxMessage;
+	std::vector<std::uint8_t> m_buffer;
+	std::vector<std::uint8_t> m_inflated;
+	PerMessageDeflate* m_deflate = nullptr;
+	bool m_compressed = false;
+	Utf8Validator m_utf8;
+	WebSocketOpcode m_opcode = WebSocketOpcode::Binary;
+	bool m_assembling = false;
+	bool m_delivered = false;
+	std::uint16_t m_closeCode = 0;
+};
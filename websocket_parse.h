@@ -1,68 +1,167 @@
-#include <iostream>
-#include <vector>
-#include <bitset>
+#pragma once
+
+#include <array>
 #include <cstdint>
-#include <string>
+#include <cstring>
 #include <span>
-#include <stdexcept>
 
+#include "websocket_frame.h"
+
+enum class WebSocketParseStatus : std::uint8_t {
+	Ok,				// 解析出一帧
+	NeedMore,		// 数据不够，读到更多数据后用剩余部分接着调用
+	Error			// 协议错误，应以error()对应的关闭码关闭连接
+};
+
+enum class WebSocketParseError : std::uint8_t {
+	None,
+	ReservedBits,		// 未协商扩展却置了RSV位
+	BadOpcode,
+	BadControlFrame,	// 控制帧分片或载荷超过125字节
+	Unmasked,			// 客户端发来的帧必须带掩码
+	BadLength,			// 64位长度最高位不为0
+	TooLarge			// 超过maxPayload
+};
+
+/*
+ * 可续传的帧解析器，不抛异常，不分配内存
+ * 帧头可以分多次送入，已读到的头部字节保存在解析器里并计入consumed；载荷必须在一次调用中完整出现，
+ * 否则返回NeedMore且不消耗载荷字节，调用方把它们留在读缓冲区里等更多数据到来
+ * 载荷在调用方的缓冲区里原地去掉掩码，frame.payload直接指向这段数据
+ */
 class WebSocketFrameParser {
 public:
-	std::vector<uint8_t> parseFrame(std::span<const uint8_t> data) {
-		if (data.size() < 2) {
-			throw std::runtime_error("Incomplete frame header");
+	explicit WebSocketFrameParser(bool requireMask = true, std::uint64_t maxPayload = 16 * 1024 * 1024)
+		: m_requireMask{requireMask}, m_maxPayload{maxPayload} {}
+
+	// 从data开头解析一帧，consumed返回本次用掉的字节数(NeedMore时也可能非0)
+	WebSocketParseStatus parse(std::span<std::uint8_t> data, std::size_t& consumed, WebSocketFrame& frame) {
+		consumed = 0;
+		if (m_error != WebSocketParseError::None) {
+			return WebSocketParseStatus::Error;
 		}
-		
-		bool fin = data[0] & 0x80;
-		uint8_t opcode = data[0] & 0x0F;
-		bool mask = data[1] & 0x80;
-		uint64_t payload_len = data[1] & 0x7F;
-		
-		size_t header_len = 2;
-		if (payload_len == 126) {
-			if (data.size() < 4) {
-				throw std::runtime_error("Incomplete extended payload length");
+		while (m_headerLen < m_headerNeed) {
+			if (consumed == data.size()) {
+				return WebSocketParseStatus::NeedMore;
 			}
-			payload_len = static_cast<uint64_t>(data[2]) << 8 | data[3];
-			header_len += 2;
-		} else if (payload_len == 127) {
-			if (data.size() < 10) {
-				throw std::runtime_error("Incomplete extended payload length");
+			std::size_t n = std::min(m_headerNeed - m_headerLen, data.size() - consumed);
+			std::memcpy(m_header.data() + m_headerLen, data.data() + consumed, n);
+			m_headerLen += n;
+			consumed += n;
+			if (m_headerLen == m_headerNeed && !onHeaderBytes()) {
+				return WebSocketParseStatus::Error;
 			}
-			payload_len = static_cast<uint64_t>(data[2]) << 56 |
-			static_cast<uint64_t>(data[3]) << 48 |
-			static_cast<uint64_t>(data[4]) << 40 |
-			static_cast<uint64_t>(data[5]) << 32 |
-			static_cast<uint64_t>(data[6]) << 24 |
-			static_cast<uint64_t>(data[7]) << 16 |
-			static_cast<uint64_t>(data[8]) << 8 |
-			data[9];
-			header_len += 8;
 		}
-		
-		if (mask) {
-			if (data.size() < header_len + 4) {
-				throw std::runtime_error("Incomplete masking key");
+
+		if (data.size() - consumed < m_length) {
+			return WebSocketParseStatus::NeedMore;
+		}
+		frame.opcode = static_cast<WebSocketOpcode>(m_header[0] & 0x0F);
+		frame.fin = m_header[0] & 0x80;
+		frame.rsv = m_header[0] & 0x70;
+		frame.masked = m_header[1] & 0x80;
+		frame.length = m_length;
+		frame.payload = data.subspan(consumed, static_cast<std::size_t>(m_length));
+		if (frame.masked) {
+			applyWebSocketMask(frame.payload, m_maskKey);
+		}
+		consumed += static_cast<std::size_t>(m_length);
+		reset();
+		return WebSocketParseStatus::Ok;
+	}
+
+	// 允许的RSV位，协商了扩展时设置
+	void setAllowedRsv(std::uint8_t rsv) { m_allowedRsv = rsv; }
+
+	void reset() {
+		m_headerLen = 0;
+		m_headerNeed = 2;
+		m_length = 0;
+		m_error = WebSocketParseError::None;
+	}
+
+	WebSocketParseError error() const { return m_error; }
+
+	// 帧头已完整、等待载荷时返回载荷长度，否则返回0；调用方据此预留连续的缓冲区
+	std::uint64_t pendingPayload() const {
+		return m_headerLen == m_headerNeed ? m_length : 0;
+	}
+
+	// 对应的关闭状态码(RFC 6455 7.4.1)
+	std::uint16_t closeCode() const {
+		return m_error == WebSocketParseError::TooLarge ? 1009 : 1002;
+	}
+
+private:
+	// 头部到达m_headerNeed字节时调用：确定还需要多少头部字节，头部完整时校验
+	bool onHeaderBytes() {
+		std::uint8_t len7 = m_header[1] & 0x7F;
+		bool mask = m_header[1] & 0x80;
+		std::size_t need = 2 + (len7 == 126 ? 2 : len7 == 127 ? 8 : 0) + (mask ? 4 : 0);
+		if (m_headerNeed == 2) {
+			if (!checkFirstBytes()) {
+				return false;
 			}
-			std::array<uint8_t, 4> masking_key{data[header_len], data[header_len + 1], data[header_len + 2], data[header_len + 3]};
-			header_len += 4;
-			
-			if (data.size() < header_len + payload_len) {
-				throw std::runtime_error("Incomplete payload data");
+			if (need > 2) {
+				m_headerNeed = need;
+				return true;
 			}
-			
-			std::vector<uint8_t> payload(data.begin() + header_len, data.begin() + header_len + payload_len);
-			for (size_t i = 0; i < payload_len; ++i) {
-				payload[i] ^= masking_key[i % 4];
+		}
+
+		std::size_t pos = 2;
+		if (len7 == 126) {
+			m_length = static_cast<std::uint64_t>(m_header[2]) << 8 | m_header[3];
+			pos += 2;
+		} else if (len7 == 127) {
+			m_length = 0;
+			for (int i = 0; i < 8; ++i) {
+				m_length = m_length << 8 | m_header[2 + i];
 			}
-			
-			return payload;
-		} else {
-			if (data.size() < header_len + payload_len) {
-				throw std::runtime_error("Incomplete payload data");
+			pos += 8;
+			if (m_length >> 63) {
+				return fail(WebSocketParseError::BadLength);
 			}
-			
-			return std::vector<uint8_t>(data.begin() + header_len, data.begin() + header_len + payload_len);
+		} else {
+			m_length = len7;
+		}
+		if (mask) {
+			std::memcpy(&m_maskKey, m_header.data() + pos, 4);
+		}
+		if (m_length > m_maxPayload) {
+			return fail(WebSocketParseError::TooLarge);
 		}
+		return true;
 	}
+
+	bool checkFirstBytes() {
+		std::uint8_t opcode = m_header[0] & 0x0F;
+		if ((m_header[0] & 0x70 & ~m_allowedRsv) != 0) {
+			return fail(WebSocketParseError::ReservedBits);
+		}
+		if ((opcode > 0x2 && opcode < 0x8) || opcode > 0xA) {
+			return fail(WebSocketParseError::BadOpcode);
+		}
+		if (isControlOpcode(static_cast<WebSocketOpcode>(opcode)) && (!(m_header[0] & 0x80) || (m_header[1] & 0x7F) > 125)) {
+			return fail(WebSocketParseError::BadControlFrame);
+		}
+		if (m_requireMask && !(m_header[1] & 0x80)) {
+			return fail(WebSocketParseError::Unmasked);
+		}
+		return true;
+	}
+
+	bool fail(WebSocketParseError e) {
+		m_error = e;
+		return false;
+	}
+
+	std::array<std::uint8_t, 14> m_header{};
+	std::size_t m_headerLen = 0;
+	std::size_t m_headerNeed = 2;
+	std::uint64_t m_length = 0;
+	std::uint32_t m_maskKey = 0;
+	bool m_requireMask;
+	std::uint8_t m_allowedRsv = 0;
+	std::uint64_t m_maxPayload;
+	WebSocketParseError m_error = WebSocketParseError::None;
 };
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <span>
+#include <utility>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "websocket_frame.h"
+
+/*
+ * 发送路径：帧头编码在栈上，和载荷一起用sendmsg的iovec发出，载荷不拷贝
+ * 广播用EncodedFrame：帧只编码一次，引用计数共享给所有连接的发送队列，帧内容不可变
+ * 服务端发出的帧不加掩码，所以同一个EncodedFrame可以原样发给任意连接
+ */
+
+class EncodedFrame;
+
+// EncodedFrame的引用，拷贝只增加计数；可以跨线程传递
+class EncodedFrameRef {
+public:
+	EncodedFrameRef() = default;
+	EncodedFrameRef(const EncodedFrameRef& other) : m_frame{other.m_frame} { retain(); }
+	EncodedFrameRef(EncodedFrameRef&& other) noexcept : m_frame{std::exchange(other.m_frame, nullptr)} {}
+	EncodedFrameRef& operator=(EncodedFrameRef other) noexcept {
+		std::swap(m_frame, other.m_frame);
+		return *this;
+	}
+	~EncodedFrameRef() { release(); }
+
+	const EncodedFrame* get() const { return m_frame; }
+	const EncodedFrame* operator->() const { return m_frame; }
+	const EncodedFrame& operator*() const { return *m_frame; }
+	explicit operator bool() const { return m_frame != nullptr; }
+
+private:
+	friend class EncodedFrame;
+	explicit EncodedFrameRef(EncodedFrame* frame) : m_frame{frame} {}
+
+	inline void retain();
+	inline void release();
+
+	EncodedFrame* m_frame = nullptr;
+};
+
+/*
+ * 编码好的完整帧(帧头+载荷)，和引用计数放在同一次分配里
+ * 只能通过make/fromBytes创建，最后一个引用释放时回收
+ */
+class EncodedFrame {
+public:
+	EncodedFrame(const EncodedFrame&) = delete;
+	EncodedFrame& operator=(const EncodedFrame&) = delete;
+
+	static EncodedFrameRef make(WebSocketOpcode opcode, std::span<const std::uint8_t> payload,
+			bool fin = true, bool compressed = false) {
+		WebSocketFrameHeader header = encodeWebSocketHeader(opcode, payload.size(), fin, compressed);
+		EncodedFrame* frame = allocate(header.size + payload.size());
+		std::memcpy(frame->data(), header.bytes, header.size);
+		if (!payload.empty()) {
+			std::memcpy(frame->data() + header.size, payload.data(), payload.size());
+		}
+		return EncodedFrameRef{frame};
+	}
+
+	// 已经编码好的字节，例如一帧没写完的剩余部分；head和tail依次拼接
+	static EncodedFrameRef fromBytes(std::span<const std::uint8_t> head, std::span<const std::uint8_t> tail = {}) {
+		EncodedFrame* frame = allocate(head.size() + tail.size());
+		if (!head.empty()) {
+			std::memcpy(frame->data(), head.data(), head.size());
+		}
+		if (!tail.empty()) {
+			std::memcpy(frame->data() + head.size(), tail.data(), tail.size());
+		}
+		return EncodedFrameRef{frame};
+	}
+
+	std::span<const std::uint8_t> bytes() const { return {data(), m_size}; }
+	std::size_t size() const { return m_size; }
+
+private:
+	friend class EncodedFrameRef;
+
+	explicit EncodedFrame(std::size_t size) : m_size{size} {}
+
+	static EncodedFrame* allocate(std::size_t size) {
+		void* memory = ::operator new(sizeof(EncodedFrame) + size);
+		return new (memory) EncodedFrame(size);
+	}
+
+	std::uint8_t* data() { return reinterpret_cast<std::uint8_t*>(this + 1); }
+	const std::uint8_t* data() const { return reinterpret_cast<const std::uint8_t*>(this + 1); }
+
+	std::atomic<std::uint32_t> m_refs{1};
+	std::size_t m_size;
+};
+
+inline void EncodedFrameRef::retain() {
+	if (m_frame) {
+		m_frame->m_refs.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+inline void EncodedFrameRef::release() {
+	if (m_frame && m_frame->m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		m_frame->~EncodedFrame();
+		::operator delete(m_frame);
+	}
+	m_frame = nullptr;
+}
+
+namespace websocket_writer {
+
+// 一次sendmsg最多带的iovec数
+inline constexpr int kMaxIov = 64;
+
+// EINTR时重试；返回写出的字节数，EAGAIN返回0，出错返回-1
+inline ssize_t sendIov(int fd, iovec* iov, int count) {
+	msghdr msg{};
+	msg.msg_iov = iov;
+	msg.msg_iovlen = static_cast<std::size_t>(count);
+	while (true) {
+		ssize_t n = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+		if (n >= 0) {
+			return n;
+		}
+		if (errno == EINTR) {
+			continue;
+		}
+		return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+	}
+}
+
+} // namespace websocket_writer
+
+/*
+ * 一个连接的发送队列，只在连接所属的线程里使用
+ * 队列为空时先直接发送，写不完的部分才进队列；队列里的帧在fd可写时用flush批量发出
+ * 帧放在vector里从m_head开始，写空时释放多余的存储(std::deque空着也要占一个块)，空闲连接几乎不占内存
+ */
+class WebSocketSendQueue {
+public:
+	// 发送一帧(服务端，不加掩码)，载荷不拷贝；只有写不完时剩余部分才拷贝进队列。返回false表示连接出错
+	bool send(int fd, WebSocketOpcode opcode, std::span<const std::uint8_t> payload,
+			bool fin = true, bool compressed = false) {
+		return sendFrame(fd, encodeWebSocketHeader(opcode, payload.size(), fin, compressed), payload);
+	}
+
+	// 客户端发送：载荷被原地加上掩码，调用返回后载荷内容已改变
+	bool sendMasked(int fd, WebSocketOpcode opcode, std::span<std::uint8_t> payload,
+			bool fin = true, bool compressed = false) {
+		std::uint32_t key = websocket_mask::randomKey();
+		applyWebSocketMask(payload, key);
+		return sendFrame(fd, encodeWebSocketHeader(opcode, payload.size(), fin, compressed, true, key), payload);
+	}
+
+	// 发送一个共享的帧，不拷贝；一次写完时不碰引用计数，广播时各线程不争用同一个计数
+	bool send(int fd, const EncodedFrameRef& frame) {
+		if (!frame || frame->size() == 0) {
+			return true;
+		}
+		if (!empty()) {
+			push(frame);
+			return flush(fd);
+		}
+		std::span<const std::uint8_t> bytes = frame->bytes();
+		iovec iov{const_cast<std::uint8_t*>(bytes.data()), bytes.size()};
+		ssize_t n = websocket_writer::sendIov(fd, &iov, 1);
+		if (n < 0) {
+			return false;
+		}
+		if (static_cast<std::size_t>(n) < bytes.size()) {
+			push(frame);
+			m_offset = static_cast<std::size_t>(n);
+			m_pending -= static_cast<std::size_t>(n);
+		}
+		return true;
+	}
+
+	// 只入队，不发送；多个帧攒在一起后由flush一次发出
+	void push(EncodedFrameRef frame) {
+		if (frame && frame->size() > 0) {
+			// 已写出的帧占了一半以上时把剩下的移到前面，vector不会一直长下去
+			if (m_head > 0 && m_head * 2 >= m_frames.size()) {
+				m_frames.erase(m_frames.begin(), m_frames.begin() + static_cast<std::ptrdiff_t>(m_head));
+				m_head = 0;
+			}
+			m_pending += frame->size();
+			m_frames.push_back(std::move(frame));
+		}
+	}
+
+	// 尽量写出队列里的数据，写到EAGAIN为止；返回false表示连接出错
+	bool flush(int fd) {
+		while (!empty()) {
+			iovec iov[websocket_writer::kMaxIov];
+			int count = 0;
+			for (std::size_t i = m_head; i < m_frames.size() && count < websocket_writer::kMaxIov; ++i, ++count) {
+				std::span<const std::uint8_t> bytes = m_frames[i]->bytes();
+				if (count == 0) {
+					bytes = bytes.subspan(m_offset);
+				}
+				iov[count] = {const_cast<std::uint8_t*>(bytes.data()), bytes.size()};
+			}
+			ssize_t n = websocket_writer::sendIov(fd, iov, count);
+			if (n < 0) {
+				return false;
+			}
+			if (n == 0) {
+				return true;
+			}
+			consume(static_cast<std::size_t>(n));
+		}
+		return true;
+	}
+
+	bool empty() const { return m_head == m_frames.size(); }
+	std::size_t pendingBytes() const { return m_pending; }
+
+	void clear() {
+		std::vector<EncodedFrameRef>().swap(m_frames);
+		m_head = 0;
+		m_offset = 0;
+		m_pending = 0;
+	}
+
+private:
+	bool sendFrame(int fd, const WebSocketFrameHeader& header, std::span<const std::uint8_t> payload) {
+		if (!empty()) {
+			// 前面还有没写完的帧，这一帧只能排队，保证顺序
+			push(EncodedFrame::fromBytes(header.view(), payload));
+			return flush(fd);
+		}
+
+		iovec iov[2] = {
+			{const_cast<std::uint8_t*>(header.bytes), header.size},
+			{const_cast<std::uint8_t*>(payload.data()), payload.size()}
+		};
+		ssize_t n = websocket_writer::sendIov(fd, iov, payload.empty() ? 1 : 2);
+		if (n < 0) {
+			return false;
+		}
+		std::size_t written = static_cast<std::size_t>(n);
+		if (written < header.size) {
+			push(EncodedFrame::fromBytes(header.view().subspan(written), payload));
+		} else if (written - header.size < payload.size()) {
+			push(EncodedFrame::fromBytes(payload.subspan(written - header.size)));
+		}
+		return true;
+	}
+
+	// 从队首去掉已写出的n字节
+	void consume(std::size_t n) {
+		m_pending -= n;
+		while (n > 0) {
+			std::size_t left = m_frames[m_head]->size() - m_offset;
+			if (n < left) {
+				m_offset += n;
+				return;
+			}
+			n -= left;
+			m_offset = 0;
+			m_frames[m_head++] = EncodedFrameRef{};
+		}
+		if (empty()) {
+			// 写空后只保留很小的容量，普通的一问一答不用每次重新分配
+			m_frames.clear();
+			m_head = 0;
+			if (m_frames.capacity() > kKeepCapacity) {
+				std::vector<EncodedFrameRef>().swap(m_frames);
+			}
+		}
+	}
+
+	static constexpr std::size_t kKeepCapacity = 4;
+
+	std::vector<EncodedFrameRef> m_frames;
+	std::size_t m_head = 0;			// 队首帧的下标
+	std::size_t m_offset = 0;		// 队首帧已写出的字节数
+	std::size_t m_pending = 0;
+};
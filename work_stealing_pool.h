@@ -0,0 +1,174 @@
+/*
+ * 工作窃取线程池，接口与ThreadPool相同(add_task)
+ * 每个worker一个Chase-Lev队列：worker内部提交的任务压入自己队列(LIFO，缓存友好)，
+ * 外部线程提交的任务轮询分散到各worker的inbox，空闲worker从别人的队列头部窃取(FIFO)
+ * 找不到任务时先自旋、再让出CPU，最后才在原子变量上休眠
+ */
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <assert.h>
+
+#include "chase_lev_deque.h"
+#include "inplace_task.h"
+
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(std::size_t thread_count = std::thread::hardware_concurrency())
+        : m_pool{std::make_shared<Pool>(thread_count > 0 ? thread_count : 1)}
+    {
+        for (std::size_t i = 0; i < m_pool->workers.size(); ++i) {
+            std::thread{[this_pool = m_pool, i] { this_pool->run(i); }}.detach();
+        }
+    }
+
+    WorkStealingPool() = default;
+
+    WorkStealingPool(WorkStealingPool&&) = default;
+
+    ~WorkStealingPool()
+    {
+        if (static_cast<bool>(m_pool)) {
+            m_pool->is_closed.store(true, std::memory_order_seq_cst);
+            m_pool->signal.fetch_add(1, std::memory_order_seq_cst);
+            m_pool->signal.notify_all();
+        }
+    }
+
+    template <typename F>
+    void add_task(F&& task)
+    {
+        m_pool->submit(new Task(std::forward<F>(task)));
+    }
+
+private:
+    // Chase-Lev队列只能存指针，任务本身用inplace_task避免再次分配
+    using Task = inplace_task<64>;
+
+    static constexpr int kSpinCount = 64;
+    static constexpr int kYieldCount = 16;
+
+    struct alignas(64) Worker {
+        chase_lev_deque<Task*> local;
+        std::mutex inbox_mtx;           // 外部提交，按worker分散以降低竞争
+        std::deque<Task*> inbox;
+        std::atomic<std::size_t> inbox_size{0};
+    };
+
+    struct Pool {
+        explicit Pool(std::size_t n) : workers(n)
+        {
+            for (auto& w : workers) w = std::make_unique<Worker>();
+        }
+
+        ~Pool()
+        {
+            for (auto& w : workers) {
+                while (auto t = w->local.pop()) delete *t;
+                for (Task* t : w->inbox) delete t;
+            }
+        }
+
+        void submit(Task* task)
+        {
+            if (t_pool == this) {
+                workers[t_index]->local.push(task);
+            } else {
+                Worker& w = *workers[next.fetch_add(1, std::memory_order_relaxed) % workers.size()];
+                std::lock_guard lock{w.inbox_mtx};
+                w.inbox.push_back(task);
+                w.inbox_size.fetch_add(1, std::memory_order_relaxed);
+            }
+            // 与worker休眠前的sleepers++配对，保证不会丢失唤醒
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sleepers.load(std::memory_order_relaxed) > 0) {
+                signal.fetch_add(1, std::memory_order_release);
+                signal.notify_one();
+            }
+        }
+
+        Task* take_inbox(Worker& w)
+        {
+            if (w.inbox_size.load(std::memory_order_relaxed) == 0) return nullptr;
+            std::lock_guard lock{w.inbox_mtx};
+            if (w.inbox.empty()) return nullptr;
+            Task* t = w.inbox.front();
+            w.inbox.pop_front();
+            w.inbox_size.fetch_sub(1, std::memory_order_relaxed);
+            return t;
+        }
+
+        Task* find_task(std::size_t self)
+        {
+            Worker& me = *workers[self];
+            if (auto t = me.local.pop()) return *t;
+            if (Task* t = take_inbox(me)) return t;
+            std::size_t n = workers.size();
+            for (std::size_t k = 1; k < n; ++k) {
+                Worker& victim = *workers[(self + k) % n];
+                if (auto t = victim.local.steal()) return *t;
+                if (Task* t = take_inbox(victim)) return t;
+            }
+            return nullptr;
+        }
+
+        void run(std::size_t self)
+        {
+            t_pool = this;
+            t_index = self;
+            while (true) {
+                Task* task = nullptr;
+                for (int i = 0; i < kSpinCount + kYieldCount && !task; ++i) {
+                    task = find_task(self);
+                    if (task) break;
+                    if (i < kSpinCount) spin_pause_();
+                    else std::this_thread::yield();
+                }
+
+                if (!task) {
+                    uint32_t epoch = signal.load(std::memory_order_acquire);
+                    sleepers.fetch_add(1, std::memory_order_seq_cst);
+                    task = find_task(self);
+                    if (!task) {
+                        if (is_closed.load(std::memory_order_seq_cst)) {
+                            sleepers.fetch_sub(1, std::memory_order_relaxed);
+                            break;
+                        }
+                        signal.wait(epoch, std::memory_order_acquire);
+                    }
+                    sleepers.fetch_sub(1, std::memory_order_relaxed);
+                    if (!task) continue;
+                }
+
+                (*task)();
+                delete task;
+            }
+            t_pool = nullptr;
+        }
+
+        static void spin_pause_() noexcept
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__)
+            asm volatile("yield");
+#endif
+        }
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::atomic<std::size_t> next{0};
+        std::atomic<uint32_t> signal{0};
+        std::atomic<uint32_t> sleepers{0};
+        std::atomic<bool> is_closed{false};
+
+        static inline thread_local Pool* t_pool = nullptr;
+        static inline thread_local std::size_t t_index = 0;
+    };
+
+    std::shared_ptr<Pool> m_pool;
+};